@@ -0,0 +1,136 @@
+#ifndef AUDIO_CPP
+#define AUDIO_CPP
+
+#include "audio.h"
+
+// Square wave beeper played from SDL's audio callback thread. The emulation side only ever stores
+// into atomics (whether the tone is on, its pitch and volume) and the callback loads them once per
+// buffer, so neither side waits on the other and a slow audio device can't stall emulation.
+// XO-CHIP programs replace the square wave with their own 128-sample 1-bit pattern (setPattern()).
+// Needs SDL_INIT_AUDIO, which SDLFrontend::initializeSDL() already requests
+class SquareWaveAudio {
+    public:
+        SquareWaveAudio() = default;
+        SquareWaveAudio(const SquareWaveAudio&) = delete;
+        SquareWaveAudio& operator=(const SquareWaveAudio&) = delete;
+
+        ~SquareWaveAudio() {
+            close();
+        }
+
+        // Opens the default output device, returns false (and stays silent) if there is none
+        bool open(float pitchHz = 440.0f, float volume = 0.25f) {
+            setPitch(pitchHz);
+            setVolume(volume);
+
+            SDL_AudioSpec want = {};
+            SDL_AudioSpec have = {};
+            want.freq = 48000;
+            want.format = AUDIO_S16SYS;
+            want.channels = 1;
+            want.samples = 512;     // ~10ms, the tone starts and stops within a frame
+            want.callback = callback;
+            want.userdata = this;
+
+            device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+            if (device == 0) {
+                std::cerr << "Audio unavailable: " << SDL_GetError() << "\n";
+                return false;
+            }
+            sampleRate = have.freq;
+            SDL_PauseAudioDevice(device, 0);
+            return true;
+        }
+
+        void close() {
+            if (device != 0) {
+                SDL_CloseAudioDevice(device);
+                device = 0;
+            }
+        }
+
+        // Called by the emulation loop once per frame, with whether the sound timer is running
+        void setTone(bool on) {
+            toneOn.store(on, std::memory_order_relaxed);
+        }
+
+        void setPitch(float hz) {
+            pitch.store(std::isfinite(hz) && hz > 0 ? hz : 440.0f, std::memory_order_relaxed);
+        }
+
+        // 0 to 1
+        void setVolume(float value) {
+            volume.store(std::min(std::max(value, 0.0f), 1.0f), std::memory_order_relaxed);
+        }
+
+        // Plays the 16-byte XO-CHIP pattern (most significant bit first) at 'rate' samples per second
+        // from now on, a rate of 0 goes back to the square wave. Only one thread may call this.
+        // The three fields are published under patternSequence, odd while they are being stored, so
+        // fill() never mixes the bits or the rate of two patterns
+        void setPattern(const uint8_t* pattern, float rate) {
+            uint64_t high = 0, low = 0;
+            for (int i = 0; i < 8; i++) {
+                high = high << 8 | pattern[i];
+                low = low << 8 | pattern[8 + i];
+            }
+            const uint32_t sequence = patternSequence.load(std::memory_order_relaxed);
+            patternSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            patternHigh.store(high, std::memory_order_relaxed);
+            patternLow.store(low, std::memory_order_relaxed);
+            patternRate.store(rate, std::memory_order_relaxed);
+            patternSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+    private:
+        SDL_AudioDeviceID device = 0;
+        int sampleRate = 48000;
+        std::atomic<bool> toneOn{false};
+        std::atomic<float> pitch{440.0f};
+        std::atomic<float> volume{0.25f};
+        std::atomic<uint64_t> patternHigh{0};   // XO-CHIP pattern bits 0-63 and 64-127
+        std::atomic<uint64_t> patternLow{0};
+        std::atomic<float> patternRate{0.0f};   // 0 plays the square wave
+        std::atomic<uint32_t> patternSequence{0}; // bumped before and after setPattern() stores, see there
+
+        // Only touched by the audio thread
+        double phase = 0.0;         // position in the current period, 0 to 1
+        float amplitude = 0.0f;     // ramps towards the target so starting and stopping doesn't click
+
+        static void callback(void* userdata, Uint8* stream, int length) {
+            static_cast<SquareWaveAudio*>(userdata)->fill(reinterpret_cast<int16_t*>(stream), length / sizeof(int16_t));
+        }
+
+        void fill(int16_t* samples, int count) {
+            const float target = toneOn.load(std::memory_order_relaxed) ? volume.load(std::memory_order_relaxed) : 0.0f;
+            // Read again if setPattern() stored in between, it only takes a few stores so this rarely loops
+            float rate;
+            uint64_t high, low;
+            uint32_t before, after;
+            do {
+                before = patternSequence.load(std::memory_order_acquire);
+                rate = patternRate.load(std::memory_order_relaxed);
+                high = patternHigh.load(std::memory_order_relaxed);
+                low = patternLow.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = patternSequence.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+            // one period is the whole 128 sample pattern, or one cycle of the square wave
+            const double step = rate > 0 ? rate / 128.0 / sampleRate : pitch.load(std::memory_order_relaxed) / sampleRate;
+            const float ramp = 1000.0f / sampleRate;     // full scale in 1ms
+
+            for (int i = 0; i < count; i++) {
+                amplitude += std::min(std::max(target - amplitude, -ramp), ramp);
+                bool up = phase < 0.5;
+                if (rate > 0) {
+                    int bit = static_cast<int>(phase * 128);
+                    up = (bit < 64 ? high >> (63 - bit) : low >> (127 - bit)) & 1;
+                }
+                samples[i] = static_cast<int16_t>((up ? 1 : -1) * amplitude * 32767);
+                phase += step;
+                if (phase >= 1.0) phase -= 1.0;
+            }
+        }
+};
+
+#endif
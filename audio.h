@@ -0,0 +1,5 @@
+#include <cstdint>
+#include <atomic>
+#include <iostream>
+#include <SDL2/SDL.h>
+#include <cmath>
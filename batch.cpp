@@ -0,0 +1,317 @@
+#ifndef BATCH_CPP
+#define BATCH_CPP
+
+#include "batch.h"
+#include "chip8.cpp"
+#include "jit.cpp"
+#include "lockstep.cpp"
+#include "romcache.cpp"
+
+// Headless batch runner: boots every ROM of a directory or manifest with its own cycle budget and
+// seed, runs them across all cores and reports one result record per ROM
+
+struct BatchJob {
+    std::string romPath;
+    uint64_t cycleBudget = 0;   // 0 = until the ROM halts or runs out
+    uint32_t seed = 0;
+};
+
+struct BatchResult {
+    std::string romPath;
+    uint64_t framebufferHash = 0;
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    const char* exitReason = "";    // "halted", "budget", "rom-end", "stack-fault" or "load-error"
+    double seconds = 0;
+};
+
+// Fixed set of tasks spread over one deque per worker. A worker takes from the back of its own deque
+// and, once that is empty, steals from the front of the others, so a few slow ROMs don't leave
+// the rest of the cores idle
+class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(unsigned threads) : queues(std::max(1u, threads)) {}
+
+        void run(size_t taskCount, const std::function<void(size_t)>& task) {
+            for (size_t i = 0; i < taskCount; i++) {
+                queues[i % queues.size()].tasks.push_back(i);
+            }
+
+            std::vector<std::thread> workers;
+            for (size_t worker = 0; worker < queues.size(); worker++) {
+                workers.emplace_back([this, worker, &task] {
+                    size_t index;
+                    while (popLocal(worker, index) || steal(worker, index)) {
+                        task(index);
+                    }
+                });
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+    private:
+        struct Queue {
+            std::mutex mux;
+            std::deque<size_t> tasks;
+        };
+        std::vector<Queue> queues;
+
+        bool popLocal(size_t worker, size_t& index) {
+            Queue& queue = queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mux);
+            if (queue.tasks.empty()) return false;
+            index = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        bool steal(size_t thief, size_t& index) {
+            for (size_t offset = 1; offset < queues.size(); offset++) {
+                Queue& victim = queues[(thief + offset) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mux);
+                if (!victim.tasks.empty()) {
+                    index = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+// A directory becomes one job per file. Anything else is read as a manifest with one
+// "path [cycles] [seed]" line per ROM, blank lines and lines starting with '#' are skipped.
+// A cycles or seed field that isn't a number fails the whole manifest (no jobs) rather than
+// reading as 0, which for cycles would mean no budget at all
+inline std::vector<BatchJob> loadBatchJobs(const std::string& path, uint64_t defaultBudget, uint32_t defaultSeed) {
+    std::vector<BatchJob> jobs;
+
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) jobs.push_back({entry.path().string(), defaultBudget, defaultSeed});
+        }
+        std::sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) { return a.romPath < b.romPath; });
+        return jobs;
+    }
+
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) {
+        std::cerr << "Problem reading batch manifest " << path << "\n";
+        return jobs;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        std::istringstream fields(line);
+        BatchJob job{"", defaultBudget, defaultSeed};
+        if (!(fields >> job.romPath) || job.romPath[0] == '#') continue;
+
+        // A missing field keeps its default, unsigned extraction would also take "-1" as a huge number
+        auto number = [&fields](auto& value) {
+            if ((fields >> std::ws).eof()) return true;
+            return fields.peek() != '-' && !(fields >> value).fail();
+        };
+        if (!number(job.cycleBudget) || !number(job.seed)) {
+            std::cerr << "Batch manifest " << path << " line " << lineNumber << ": cycles and seed must be unsigned numbers\n";
+            return {};
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// Runs one job from 'boot', its ROM's image in the cache, nullptr if the ROM failed to load
+inline BatchResult runBatchJob(const BatchJob& job, const Chip8* boot, int cyclesPerFrame, bool useJIT) {
+    BatchResult result;
+    result.romPath = job.romPath;
+
+    if (!boot) {
+        result.exitReason = "load-error";
+        return result;
+    }
+    Chip8 chip8 = *boot;
+    chip8.seedRandom(job.seed);
+
+    std::unique_ptr<Chip8JIT> jit(useJIT ? new Chip8JIT() : nullptr);
+    auto start = std::chrono::steady_clock::now();
+
+    result.exitReason = "rom-end";
+    while (chip8.hasMoreOpcodes()) {
+        int budget = cyclesPerFrame;
+        if (job.cycleBudget != 0 && job.cycleBudget - chip8.cycleCount < (uint64_t)budget) {
+            budget = job.cycleBudget - chip8.cycleCount;
+        }
+
+        if (jit) {
+            jit->runFrame(chip8, budget);
+        } else {
+            chip8.runFrame(budget);
+        }
+
+        if (job.cycleBudget != 0 && chip8.cycleCount >= job.cycleBudget) {
+            result.exitReason = "budget";
+            break;
+        }
+        if (chip8.isHalted()) {
+            result.exitReason = "halted";
+            break;
+        }
+    }
+
+    if (chip8.stackFault) {
+        result.exitReason = "stack-fault";
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.framebufferHash = chip8.framebufferHash();
+    result.cycles = chip8.cycleCount;
+    result.frames = chip8.frameCount;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+// Every job once per seed from its own seed up, for sweeps over CXNN outcomes
+inline std::vector<BatchJob> sweepBatchJobs(const std::vector<BatchJob>& jobs, unsigned seeds) {
+    std::vector<BatchJob> sweep;
+    for (const BatchJob& job : jobs) {
+        for (unsigned offset = 0; offset < seeds; offset++) {
+            sweep.push_back({job.romPath, job.cycleBudget, job.seed + offset});
+        }
+    }
+    return sweep;
+}
+
+// Runs jobs[first, first + count), all of the same ROM, as the lanes of one LockstepChip8, with the
+// same frames and exit checks runBatchJob() has. Every lane reports the time the whole group took
+inline void runLockstepJobs(const std::vector<BatchJob>& jobs, size_t first, size_t count, const Chip8* boot,
+                            int cyclesPerFrame, std::vector<BatchResult>& results) {
+    if (!boot) {
+        for (size_t lane = 0; lane < count; lane++) {
+            results[first + lane].romPath = jobs[first + lane].romPath;
+            results[first + lane].exitReason = "load-error";
+        }
+        return;
+    }
+
+    std::unique_ptr<LockstepChip8> lockstep(new LockstepChip8());
+    bool live[LockstepChip8::LANES] = {};
+    for (int lane = 0; lane < LockstepChip8::LANES; lane++) {
+        Chip8 chip8 = *boot;
+        if (lane < (int)count) {
+            chip8.seedRandom(jobs[first + lane].seed);
+            results[first + lane].romPath = jobs[first + lane].romPath;
+            results[first + lane].exitReason = "rom-end";
+            live[lane] = chip8.hasMoreOpcodes();
+        }
+        lockstep->load(lane, chip8);
+        if (!live[lane]) {
+            lockstep->park(lane);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t budgets[LockstepChip8::LANES] = {};
+    bool running = true;
+    while (running) {
+        for (int lane = 0; lane < (int)count; lane++) {
+            const BatchJob& job = jobs[first + lane];
+            uint64_t cycles = lockstep->cycleCount(lane);
+            budgets[lane] = cyclesPerFrame;
+            if (job.cycleBudget != 0 && job.cycleBudget - cycles < (uint64_t)cyclesPerFrame) {
+                budgets[lane] = job.cycleBudget - cycles;
+            }
+        }
+        lockstep->runFrame(budgets);
+
+        running = false;
+        for (int lane = 0; lane < (int)count; lane++) {
+            if (!live[lane]) continue;
+            const BatchJob& job = jobs[first + lane];
+            if (job.cycleBudget != 0 && lockstep->cycleCount(lane) >= job.cycleBudget) {
+                results[first + lane].exitReason = "budget";
+                live[lane] = false;
+            } else if (lockstep->isHalted(lane)) {
+                results[first + lane].exitReason = "halted";
+                live[lane] = false;
+            } else if (!lockstep->hasMoreOpcodes(lane)) {
+                if (lockstep->stackFault(lane)) results[first + lane].exitReason = "stack-fault";
+                live[lane] = false;
+            }
+            if (!live[lane]) {
+                lockstep->park(lane);
+            }
+            running = running || live[lane];
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int lane = 0; lane < (int)count; lane++) {
+        const Chip8& chip8 = lockstep->machine(lane);
+        BatchResult& result = results[first + lane];
+        result.framebufferHash = chip8.framebufferHash();
+        result.cycles = chip8.cycleCount;
+        result.frames = chip8.frameCount;
+        result.seconds = elapsed.count();
+    }
+}
+
+// One JSON object per line
+inline void printBatchResult(std::ostream& out, const BatchResult& result) {
+    std::string rom;
+    for (char c : result.romPath) {
+        if (c == '"' || c == '\\') rom += '\\';
+        rom += c;
+    }
+    out << "{\"rom\": \"" << rom << "\", \"hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << result.framebufferHash
+        << std::dec << std::setfill(' ') << "\", \"cycles\": " << result.cycles << ", \"frames\": " << result.frames
+        << ", \"exit\": \"" << result.exitReason << "\", \"seconds\": " << result.seconds << "}\n";
+}
+
+// Runs every job on 'threads' workers (0 = one per core) and prints the results in job order,
+// returns the number of ROMs that failed to load. With 'lockstep', runs of consecutive jobs on the
+// same ROM (by content) go through LockstepChip8 a group of lanes at a time, with identical results
+inline int runBatch(const std::vector<BatchJob>& jobs, unsigned threads, int cyclesPerFrame, bool useJIT, bool lockstep = false) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Every ROM is read and booted once up front, jobs start from a copy of its image
+    RomCache roms;
+    for (const BatchJob& job : jobs) {
+        roms.add(job.romPath);
+    }
+
+    // Tasks as [first job, job count), one job each unless grouped for lockstep
+    std::vector<std::pair<size_t, size_t>> tasks;
+    for (size_t first = 0; first < jobs.size();) {
+        size_t count = 1;
+        while (lockstep && first + count < jobs.size() && count < (size_t)LockstepChip8::LANES
+               && roms.find(jobs[first + count].romPath) == roms.find(jobs[first].romPath)) {
+            count++;
+        }
+        tasks.push_back({first, count});
+        first += count;
+    }
+
+    std::vector<BatchResult> results(jobs.size());
+    WorkStealingPool pool(std::min<size_t>(threads, std::max<size_t>(tasks.size(), 1)));
+    pool.run(tasks.size(), [&](size_t index) {
+        const BatchJob& job = jobs[tasks[index].first];
+        if (lockstep) {
+            runLockstepJobs(jobs, tasks[index].first, tasks[index].second, roms.find(job.romPath), cyclesPerFrame, results);
+        } else {
+            results[tasks[index].first] = runBatchJob(job, roms.find(job.romPath), cyclesPerFrame, useJIT);
+        }
+    });
+
+    int failures = 0;
+    for (const BatchResult& result : results) {
+        printBatchResult(std::cout, result);
+        if (std::string(result.exitReason) == "load-error") failures++;
+    }
+    return failures;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
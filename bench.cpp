@@ -0,0 +1,1038 @@
+#include "chip8.h"
+#include "chip8.cpp"
+#include "jit.h"
+#include "jit.cpp"
+#include "framebuffer.h"
+#include "framebuffer.cpp"
+#include "snapshot.h"
+#include "snapshot.cpp"
+#include "rewind.h"
+#include "rewind.cpp"
+#include "lockstep.h"
+#include "lockstep.cpp"
+#include "romcache.h"
+#include "romcache.cpp"
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include <map>
+
+// Headless benchmarks. The first part compares the original switch decoder, the handler table,
+// computed-goto threading and the basic-block JIT on every ROM in assets/ROMS and on a few inline
+// self-modifying programs: each mode runs the same number of 60Hz frames from a fresh boot and the
+// final machine states are compared against the switch interpreter, so a dispatch or translation bug
+// shows up as a mismatch. LockstepChip8 is
+// checked the same way against a Chip8 per lane, and the test ROMs' final displays against golden
+// hashes. The second part is a suite of microbenchmarks (dispatch per opcode family, DXYN, whole ROMs,
+// snapshots, the golden runs) whose results can also be written as Google Benchmark compatible JSON
+// and compared against an earlier run to catch regressions
+
+enum class DispatchMode { Switch, Table, Threaded, JIT };
+
+const char* dispatchModeName(DispatchMode mode) {
+    switch (mode) {
+        case DispatchMode::Switch: return "switch";
+        case DispatchMode::Table: return "table";
+        case DispatchMode::Threaded: return "threaded";
+        case DispatchMode::JIT: return "jit";
+    }
+    return "?";
+}
+
+// Runs 'frames' frames of 'cyclesPerFrame' instructions with the given dispatch, returns the elapsed seconds
+double runDispatch(Chip8& chip8, DispatchMode mode, uint64_t frames, int cyclesPerFrame) {
+    std::unique_ptr<Chip8JIT> jit(mode == DispatchMode::JIT ? new Chip8JIT() : nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < frames && chip8.hasMoreOpcodes(); frame++) {
+        int executed = 0;
+        if (mode == DispatchMode::Switch) {
+            for (; executed < cyclesPerFrame && chip8.hasMoreOpcodes(); executed++) chip8.decodeNextOpCodeSwitch();
+        } else if (mode == DispatchMode::Table) {
+            for (; executed < cyclesPerFrame && chip8.hasMoreOpcodes(); executed++) chip8.decodeNextOpCode();
+        } else if (mode == DispatchMode::JIT) {
+            executed = jit->execute(chip8, cyclesPerFrame);
+        } else {
+#if CHIP8_COMPUTED_GOTO
+            executed = chip8.executeThreaded(cyclesPerFrame);
+#else
+            for (; executed < cyclesPerFrame && chip8.hasMoreOpcodes(); executed++) chip8.decodeNextOpCode();
+#endif
+        }
+        chip8.cycleCount += executed;
+        chip8.frameCount++;
+        chip8.tickTimers();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+bool sameState(const Chip8& a, const Chip8& b) {
+    return std::memcmp(a.memory, b.memory, sizeof(a.memory)) == 0
+        && std::memcmp(a.registers, b.registers, sizeof(a.registers)) == 0
+        && std::memcmp(a.stack, b.stack, sizeof(a.stack)) == 0
+        && std::memcmp(a.gfx, b.gfx, sizeof(a.gfx)) == 0
+        && a.I == b.I && a.pc == b.pc && a.sp == b.sp
+        && a.delay_timer == b.delay_timer && a.sound_timer == b.sound_timer
+        && a.cycleCount == b.cycleCount && a.stackFault == b.stackFault;
+}
+
+// Times every framebuffer expansion kernel the CPU supports at 1x and 4x and checks them against the scalar one
+bool benchExpansion() {
+    uint64_t rows[32];
+    uint64_t seed = 0x9E3779B97F4A7C15;
+    for (uint64_t& row : rows) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        row = seed;
+    }
+    const Palette palette{0x102030FF, 0xE0F0C0FF};
+    const ExpandKernel kernels[] = { ExpandKernel::Scalar, ExpandKernel::SSE2, ExpandKernel::AVX2 };
+    bool allMatch = true;
+
+    std::cout << "\n" << std::left << std::setw(28) << "framebuffer expansion" << std::right << std::setw(14) << "scale" << std::setw(14) << "ns/frame" << "\n";
+
+    for (int scale : {1, 4}) {
+        const int pitch = 64 * scale;
+        std::vector<uint32_t> reference(pitch * 32 * scale);
+        std::vector<uint32_t> pixels(reference.size());
+        expandFramebuffer(rows, 0, 31, reference.data(), pitch, palette, scale, ExpandKernel::Scalar);
+
+        for (ExpandKernel kernel : kernels) {
+            if (!expandKernelSupported(kernel)) continue;
+
+            const int iterations = 200000 / (scale * scale);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                rows[i & 31] ^= 1;   // keep the compiler from hoisting the work out of the loop
+                expandFramebuffer(rows, 0, 31, pixels.data(), pitch, palette, scale, kernel);
+                rows[i & 31] ^= 1;
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            expandFramebuffer(rows, 0, 31, pixels.data(), pitch, palette, scale, kernel);
+            bool match = pixels == reference;
+            allMatch = allMatch && match;
+
+            std::cout << std::left << std::setw(28) << expandKernelName(kernel) << std::right << std::setw(14) << scale
+                      << std::setw(14) << std::setprecision(1) << elapsed.count() / iterations << (match ? "" : "   OUTPUT MISMATCH") << "\n";
+        }
+    }
+    return allMatch;
+}
+
+// Self-modifying programs the test ROMs don't cover: each calls a routine, rewrites its first
+// instruction through an FX55 whose range the interpreter masks to 12 bits, then calls it again.
+// A JIT block that isn't dropped keeps running the old instruction
+struct InlineRom {
+    const char* name;
+    std::vector<uint8_t> code;
+};
+
+const InlineRom SELF_MODIFYING[] = {
+    {"inline/write-above-4k", {
+        0x22, 0x18,     // 200: call 218, VA = 01
+        0xAE, 0x1C,     // 202: I = E1C
+        0x65, 0xFF,     // 204: V5 = FF
+        0xF5, 0x1E,     // 206: I += FF, four times: I = 1218
+        0xF5, 0x1E,
+        0xF5, 0x1E,
+        0xF5, 0x1E,
+        0x60, 0x6A,     // 20E: V0 = 6A
+        0x61, 0x07,     // 210: V1 = 07
+        0xF1, 0x55,     // 212: write 6A07 at 1218 & FFF = 218
+        0x22, 0x18,     // 214: call 218, VA = 07
+        0x12, 0x16,     // 216: halt
+        0x6A, 0x01,     // 218: VA = 01
+        0x00, 0xEE,     // 21A: return
+    }},
+    {"inline/write-wrapping", {
+        0x60, 0x6A,     // 200: V0 = 6A
+        0x61, 0x01,     // 202: V1 = 01
+        0x62, 0x00,     // 204: V2 = 00
+        0x63, 0xEE,     // 206: V3 = EE
+        0xA0, 0x00,     // 208: I = 000
+        0xF3, 0x55,     // 20A: write 6A01 00EE at 000
+        0x20, 0x00,     // 20C: call 000, VA = 01
+        0xAF, 0xFF,     // 20E: I = FFF
+        0x60, 0x00,     // 210: V0 = 00
+        0x61, 0x6A,     // 212: V1 = 6A
+        0x62, 0x07,     // 214: V2 = 07
+        0xF2, 0x55,     // 216: write 00 6A07 at FFF, wrapping to 000
+        0x20, 0x00,     // 218: call 000, VA = 07
+        0x12, 0x1A,     // 21A: halt
+    }},
+};
+
+// Runs a booted machine with every dispatch mode and prints its row, returns false if any of them ends in another state
+bool compareModes(const Chip8& boot, const std::string& name, uint64_t frames, int cyclesPerFrame) {
+    const DispatchMode modes[] = { DispatchMode::Switch, DispatchMode::Table, DispatchMode::Threaded, DispatchMode::JIT };
+    const int modeCount = sizeof(modes) / sizeof(modes[0]);
+    Chip8 reference = boot;
+    double mips[modeCount] = {0};
+    bool match = true;
+
+    for (int i = 0; i < modeCount; i++) {
+        Chip8 chip8 = boot;
+        double seconds = runDispatch(chip8, modes[i], frames, cyclesPerFrame);
+        mips[i] = seconds > 0 ? chip8.cycleCount / seconds / 1e6 : 0.0;
+        if (i == 0) {
+            reference = chip8;
+        } else if (!sameState(reference, chip8)) {
+            match = false;
+        }
+    }
+
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1);
+    for (double value : mips) std::cout << std::setw(14) << value;
+    std::cout << std::setw(9) << std::setprecision(2) << (mips[0] > 0 ? *std::max_element(mips, mips + modeCount) / mips[0] : 0.0) << "x";
+    if (!match) std::cout << "   STATE MISMATCH";
+    std::cout << "\n";
+    return match;
+}
+
+// Runs every ROM, then the self-modifying inline ones, with every dispatch mode, returns false if any of them ends in another state
+bool compareDispatch(const std::vector<std::string>& roms, uint64_t frames, int cyclesPerFrame) {
+    bool allMatch = true;
+
+    std::cout << std::left << std::setw(28) << "ROM";
+    for (DispatchMode mode : { DispatchMode::Switch, DispatchMode::Table, DispatchMode::Threaded, DispatchMode::JIT }) {
+        std::cout << std::right << std::setw(14) << dispatchModeName(mode);
+    }
+    std::cout << std::setw(10) << "speedup" << "   (million instructions/s)\n";
+
+    for (const std::string& rom : roms) {
+        Chip8 boot;
+        boot.loadFontset();
+        if (!boot.loadROM(rom)) continue;
+        allMatch = compareModes(boot, std::filesystem::path(rom).filename().string(), frames, cyclesPerFrame) && allMatch;
+    }
+    for (const InlineRom& rom : SELF_MODIFYING) {
+        Chip8 boot;
+        boot.loadFontset();
+        boot.loadROM(rom.code.data(), rom.code.size());
+        allMatch = compareModes(boot, rom.name, frames, cyclesPerFrame) && allMatch;
+    }
+
+    return benchExpansion() && allMatch;
+}
+
+// Boots every lane of 'lockstep' and of 'reference' on the ROM with seeds 1-16, the last four lanes with
+// a key held so they take other branches than the rest
+bool bootLanes(const std::string& rom, LockstepChip8& lockstep, Chip8* reference) {
+    Chip8 boot;
+    boot.loadFontset();
+    if (!boot.loadROM(rom)) return false;
+    for (int lane = 0; lane < LockstepChip8::LANES; lane++) {
+        reference[lane] = boot;
+        reference[lane].seedRandom(lane + 1);
+        if (lane >= LockstepChip8::LANES - 4) reference[lane].setKeypadMask(1 << lane % 16);
+        lockstep.load(lane, reference[lane]);
+    }
+    return true;
+}
+
+// Runs every ROM on 16 lanes in lockstep and on a Chip8 per lane, the same instructions in total as one
+// dispatch mode above. Returns false if any lane ends in another state than its Chip8
+bool compareLockstep(const std::vector<std::string>& roms, uint64_t frames, int cyclesPerFrame) {
+    const int lanes = LockstepChip8::LANES;
+    bool allMatch = true;
+
+    std::cout << "\n" << std::left << std::setw(28) << "lockstep x" + std::to_string(lanes) << std::right << std::setw(14) << "per lane"
+              << std::setw(14) << "lockstep" << std::setw(10) << "speedup" << std::setw(10) << "vector" << "   (million instructions/s)\n";
+
+    std::unique_ptr<LockstepChip8> lockstep(new LockstepChip8());
+    std::vector<Chip8> reference(lanes);
+    for (const std::string& rom : roms) {
+        if (!bootLanes(rom, *lockstep, reference.data())) continue;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t frame = 0; frame < frames / lanes; frame++) {
+            for (Chip8& chip8 : reference) chip8.runFrame(cyclesPerFrame);
+        }
+        std::chrono::duration<double> scalarElapsed = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (uint64_t frame = 0; frame < frames / lanes; frame++) {
+            lockstep->runFrame(cyclesPerFrame);
+        }
+        std::chrono::duration<double> lockstepElapsed = std::chrono::steady_clock::now() - start;
+
+        bool match = true;
+        uint64_t instructions = 0;
+        for (int lane = 0; lane < lanes; lane++) {
+            const Chip8& chip8 = lockstep->machine(lane);
+            match = match && sameState(reference[lane], chip8) && reference[lane].randomState == chip8.randomState
+                && reference[lane].frameCount == chip8.frameCount && reference[lane].beepFlag == chip8.beepFlag;
+            instructions += chip8.cycleCount;
+        }
+        double scalarMips = scalarElapsed.count() > 0 ? instructions / scalarElapsed.count() / 1e6 : 0.0;
+        double lockstepMips = lockstepElapsed.count() > 0 ? instructions / lockstepElapsed.count() / 1e6 : 0.0;
+        uint64_t steps = lockstep->vectorSteps + lockstep->laneSteps;
+
+        std::cout << std::left << std::setw(28) << std::filesystem::path(rom).filename().string() << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << scalarMips << std::setw(14) << lockstepMips
+                  << std::setw(9) << std::setprecision(2) << (scalarMips > 0 ? lockstepMips / scalarMips : 0.0) << "x"
+                  << std::setw(9) << std::setprecision(0) << (steps ? 100.0 * lockstep->vectorSteps / steps : 0.0) << "%";
+        if (!match) std::cout << "   STATE MISMATCH";
+        std::cout << "\n";
+        allMatch = allMatch && match;
+        lockstep->vectorSteps = lockstep->laneSteps = 0;
+    }
+    return allMatch;
+}
+
+// Final display of the test ROMs in assets/ROMS, each hash taken from a run where the ROM shows every
+// one of its checks as passed. A run boots the ROM and stops once it halts, or after GOLDEN_FRAMES
+// frames for the ROMs that end up waiting for input instead
+struct GoldenFrame {
+    const char* rom;
+    const char* quirks;         // profile the ROM expects, as for --quirks
+    uint8_t platform;           // poked into 0x1FF before booting, Timendus' ROMs then skip their menu (0: left alone)
+    uint16_t keys;              // held from the start, bit n is key n
+    uint64_t framebufferHash;
+};
+
+const GoldenFrame GOLDEN[] = {
+    {"1-chip8-logo.ch8", "vip", 0, 0, 0x2779b329dd6a179e},
+    {"3-corax+.ch8", "vip", 0, 0, 0x6b93af0c74789d12},
+    {"4-flags.ch8", "vip", 0, 0, 0xc46fe129f9c54965},
+    {"5-quirks.ch8", "vip", 1, 0, 0x65e2c6f38d65817f},
+    {"5-quirks.ch8", "schip", 2, 0, 0x4f78754ba028d8b9},
+    {"5-quirks.ch8", "xochip", 3, 0, 0xa95dbd8d5d6863d9},
+    {"6-keypad.ch8", "vip", 1, 1 << 5, 0x1756a3c5af1a1335},  // EX9E test, key 5 shows as held
+    {"BC_test.ch8", "schip", 0, 0, 0xf80d553e604fb9ed},      // shifts VX in place and leaves I alone in FX55/FX65
+    {"ibm.ch8", "vip", 0, 0, 0xc094f65422bd4e58},
+};
+const uint64_t GOLDEN_FRAMES = 600;
+const int GOLDEN_CYCLES_PER_FRAME = 1000;
+
+// Boots the golden run's ROM on the machine its quirks need and passes it to 'body', returns false if the ROM doesn't load
+template <typename Body>
+bool withGoldenBoot(const std::string& path, const GoldenFrame& golden, Body body) {
+    auto boot = [&](auto& chip8) {
+        chip8.loadFontset();
+        if (!chip8.loadROM(path)) return false;
+        if (golden.platform != 0) chip8.memory[0x1FF] = golden.platform;
+        chip8.setKeypadMask(golden.keys);
+        body(chip8);
+        return true;
+    };
+    std::string quirks = golden.quirks;
+    if (quirks == "schip") {
+        std::unique_ptr<SuperChip8> chip8(new SuperChip8());
+        return boot(*chip8);
+    } else if (quirks == "xochip") {
+        std::unique_ptr<XOChip8> chip8(new XOChip8());
+        return boot(*chip8);
+    }
+    std::unique_ptr<Chip8> chip8(new Chip8());
+    return boot(*chip8);
+}
+
+// Runs a booted machine until it halts or GOLDEN_FRAMES have passed, through the JIT with 'useJIT' (CHIP-8 only)
+template <typename Machine>
+void runGoldenFrames(Machine& chip8, bool useJIT) {
+    std::unique_ptr<Chip8JIT> jit(useJIT ? new Chip8JIT() : nullptr);
+    for (uint64_t frame = 0; frame < GOLDEN_FRAMES && chip8.hasMoreOpcodes() && !chip8.isHalted(); frame++) {
+        if constexpr (std::is_same<Machine, Chip8>::value) {
+            if (jit) {
+                jit->runFrame(chip8, GOLDEN_CYCLES_PER_FRAME);
+                continue;
+            }
+        }
+        chip8.runFrame(GOLDEN_CYCLES_PER_FRAME);
+    }
+}
+
+std::string goldenName(const GoldenFrame& golden) {
+    return std::string(golden.rom) + "/" + golden.quirks;
+}
+
+// Checks every golden ROM in 'romDir' on the interpreter, and on the JIT where it applies.
+// Returns false if any final display differs from its golden hash or a ROM is missing
+bool checkGoldenFrames(const std::string& romDir) {
+    bool allMatch = true;
+    std::cout << "\n" << std::left << std::setw(28) << "conformance" << std::right << std::setw(14) << "interpreter"
+              << std::setw(14) << "jit" << std::setw(14) << "cycles" << "\n";
+
+    for (const GoldenFrame& golden : GOLDEN) {
+        std::string path = (std::filesystem::path(romDir) / golden.rom).string();
+        std::cout << std::left << std::setw(28) << goldenName(golden) << std::right;
+        if (!std::filesystem::exists(path)) {
+            std::cout << std::setw(14) << "missing" << "\n";
+            allMatch = false;
+            continue;
+        }
+
+        bool match = false, jitMatch = false;
+        uint64_t hash = 0, cycles = 0;
+        bool classic = std::string(golden.quirks) == "vip";
+        withGoldenBoot(path, golden, [&](const auto& boot) {
+            auto chip8 = boot;
+            runGoldenFrames(chip8, false);
+            hash = chip8.framebufferHash();
+            cycles = chip8.cycleCount;
+            match = hash == golden.framebufferHash;
+            if (classic) {
+                chip8 = boot;
+                runGoldenFrames(chip8, true);
+                jitMatch = chip8.framebufferHash() == golden.framebufferHash;
+            }
+        });
+        std::cout << std::setw(14) << (match ? "ok" : "FAIL") << std::setw(14) << (!classic ? "-" : jitMatch ? "ok" : "FAIL")
+                  << std::setw(14) << cycles;
+        match = match && (jitMatch || !classic);
+        if (!match) std::cout << "   framebuffer " << std::hex << hash << ", golden " << golden.framebufferHash << std::dec;
+        std::cout << "\n";
+        allMatch = allMatch && match;
+    }
+    return allMatch;
+}
+
+// No test ROM in assets/ROMS runs on the chip48 profile, so this inline one covers the quirks it alone
+// combines: 8XY6/8XYE shift Vx in place, BXNN jumps to XNN + Vx and FX55/FX65 advance I by X.
+// Printed as a row of the conformance table above, returns false if a register or I ends up elsewhere
+bool checkChip48Quirks() {
+    static const uint8_t rom[] = {
+        0x60, 0x05,     // 200: V0 = 05
+        0x61, 0x03,     // 202: V1 = 03
+        0x80, 0x16,     // 204: V0 >>= 1, V0 = 02 and VF = 1 (vip: V0 = V1 >> 1 = 01)
+        0x62, 0x81,     // 206: V2 = 81
+        0x63, 0x01,     // 208: V3 = 01
+        0x82, 0x3E,     // 20A: V2 <<= 1, V2 = 02 and VF = 1 (vip: V2 = V3 << 1 = 02, VF = 0)
+        0xB2, 0x0E,     // 20C: jump to 20E + V2 = 210 (vip: 20E + V0)
+        0x12, 0x0E,     // 20E: trap
+        0xA3, 0x00,     // 210: I = 300
+        0xF2, 0x55,     // 212: store V0-V2 at 300, I = 302 (vip: 303)
+        0xF1, 0x65,     // 214: load V0-V1 from 302, V0 = 02 and V1 = 00, I = 303
+        0x64, 0x05,     // 216: V4 = 05, the jump landed
+        0x12, 0x18,     // 218: halt
+    };
+    const uint8_t expected[16] = {0x02, 0x00, 0x02, 0x01, 0x05, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01};
+
+    std::unique_ptr<Chip48> chip8(new Chip48());
+    chip8->loadFontset();
+    chip8->loadROM(rom, sizeof(rom));
+    chip8->runFrame(GOLDEN_CYCLES_PER_FRAME);
+
+    bool match = std::equal(expected, expected + 16, chip8->registers) && chip8->I == 0x303 && chip8->pc == 0x218;
+    std::cout << std::left << std::setw(28) << "inline/chip48" << std::right << std::setw(14) << (match ? "ok" : "FAIL")
+              << std::setw(14) << "-" << std::setw(14) << chip8->cycleCount;
+    if (!match) {
+        std::cout << "   V0-V4 " << std::hex;
+        for (int i = 0; i < 5; i++) std::cout << int(chip8->registers[i]) << " ";
+        std::cout << "VF " << int(chip8->registers[15]) << " I " << chip8->I << " pc " << chip8->pc << std::dec;
+    }
+    std::cout << "\n";
+    return match;
+}
+
+// FX75/FX85 with X above 7 on SUPER-CHIP, which only has eight RPL flags: V0-V7 are saved and loaded
+// rather than X wrapping to fewer. Printed as a row of the conformance table, returns false on a mismatch
+bool checkRplFlags() {
+    static const uint8_t rom[] = {
+        0x60, 0x10, 0x61, 0x11, 0x62, 0x12, 0x63, 0x13, 0x64, 0x14,     // 200: V0-V4 = 10-14
+        0x65, 0x15, 0x66, 0x16, 0x67, 0x17, 0x68, 0x18, 0x69, 0x19,     // 20A: V5-V9 = 15-19
+        0xF9, 0x75,                                                     // 214: save V0-V7 (V9 clamps to 7)
+        0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0x63, 0x00, 0x64, 0x00,     // 216: clear V0-V4
+        0x65, 0x00, 0x66, 0x00, 0x67, 0x00, 0x68, 0x00, 0x69, 0x00,     // 220: clear V5-V9
+        0xF9, 0x85,                                                     // 22A: load V0-V7
+        0x12, 0x2C,                                                     // 22C: halt
+    };
+    const uint8_t expected[16] = {0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    std::unique_ptr<SuperChip8> chip8(new SuperChip8());
+    chip8->loadFontset();
+    chip8->loadROM(rom, sizeof(rom));
+    chip8->runFrame(GOLDEN_CYCLES_PER_FRAME);
+
+    bool match = std::equal(expected, expected + 16, chip8->registers) && chip8->pc == 0x22C;
+    std::cout << std::left << std::setw(28) << "inline/schip-rpl-flags" << std::right << std::setw(14) << (match ? "ok" : "FAIL")
+              << std::setw(14) << "-" << std::setw(14) << chip8->cycleCount;
+    if (!match) {
+        std::cout << "   V0-V9 " << std::hex;
+        for (int i = 0; i < 10; i++) std::cout << int(chip8->registers[i]) << " ";
+        std::cout << "pc " << chip8->pc << std::dec;
+    }
+    std::cout << "\n";
+    return match;
+}
+
+// A 16th nested 2NNN and a 00EE with nothing to return to stop the machine with a stack fault instead
+// of going past either end of the stack. The interpreter column also runs them as lockstep lanes, which
+// have to end in the same state, as does the JIT. Printed as rows of the conformance table
+bool checkStackFaults() {
+    static const uint8_t overflow[] = {0x22, 0x00};     // 200: call 200, forever
+    static const uint8_t underflow[] = {0x00, 0xEE};    // 200: return with an empty stack
+    struct StackCase {
+        const char* name;
+        const uint8_t* rom;
+        size_t size;
+        uint8_t sp;             // where the stack is left
+        uint64_t cycles;        // the faulting instruction included
+    };
+    const StackCase cases[] = {
+        {"inline/stack-overflow", overflow, sizeof(overflow), 15, 16},
+        {"inline/stack-underflow", underflow, sizeof(underflow), 0, 1},
+    };
+
+    bool allMatch = true;
+    std::unique_ptr<LockstepChip8> lockstep(new LockstepChip8());
+    for (const StackCase& test : cases) {
+        std::unique_ptr<Chip8> boot(new Chip8());
+        boot->loadFontset();
+        boot->loadROM(test.rom, test.size);
+
+        std::unique_ptr<Chip8> chip8(new Chip8(*boot));
+        chip8->runFrame(GOLDEN_CYCLES_PER_FRAME);
+        bool match = chip8->stackFault && chip8->sp == test.sp && chip8->cycleCount == test.cycles
+            && !chip8->hasMoreOpcodes() && chip8->keypadMask() == 0;
+
+        for (int lane = 0; lane < LockstepChip8::LANES; lane++) lockstep->load(lane, *boot);
+        lockstep->runFrame(GOLDEN_CYCLES_PER_FRAME);
+        for (int lane = 0; lane < LockstepChip8::LANES; lane++) {
+            match = match && lockstep->stackFault(lane) && !lockstep->hasMoreOpcodes(lane) && sameState(*chip8, lockstep->machine(lane));
+        }
+
+        std::unique_ptr<Chip8> jitted(new Chip8(*boot));
+        Chip8JIT jit;
+        jit.runFrame(*jitted, GOLDEN_CYCLES_PER_FRAME);
+        bool jitMatch = sameState(*chip8, *jitted);
+
+        std::cout << std::left << std::setw(28) << test.name << std::right << std::setw(14) << (match ? "ok" : "FAIL")
+                  << std::setw(14) << (jitMatch ? "ok" : "FAIL") << std::setw(14) << chip8->cycleCount;
+        if (!match) std::cout << "   fault " << chip8->stackFault << " sp " << int(chip8->sp);
+        std::cout << "\n";
+        allMatch = allMatch && match && jitMatch;
+    }
+    return allMatch;
+}
+
+// One benchmark run, named and reported the way Google Benchmark does
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double realNanoseconds;     // per iteration
+    double cpuNanoseconds;      // per iteration
+    double itemsPerSecond;      // 0 when the benchmark doesn't count items
+};
+
+// Minimal Google Benchmark style runner: a body runs 'iterations' times and returns how many items
+// (instructions, sprites, ...) it processed, the iteration count grows until a run lasts 'minTime'
+class BenchSuite {
+    public:
+        double minTime = 0.25;      // seconds
+        std::string filter;         // only run benchmarks whose name contains this
+        std::vector<BenchResult> results;
+
+        void run(const std::string& name, const std::function<uint64_t(uint64_t)>& body) {
+            if (!filter.empty() && name.find(filter) == std::string::npos) {
+                return;
+            }
+
+            uint64_t iterations = 1;
+            while (true) {
+                std::clock_t cpuStart = std::clock();
+                auto start = std::chrono::steady_clock::now();
+                uint64_t items = body(iterations);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+                if (elapsed.count() >= minTime || iterations >= (1ull << 40)) {
+                    BenchResult result{name, iterations, elapsed.count() * 1e9 / iterations, cpuSeconds * 1e9 / iterations,
+                                       elapsed.count() > 0 ? items / elapsed.count() : 0.0};
+                    std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(1)
+                              << std::setw(14) << result.realNanoseconds << std::setw(14) << iterations;
+                    if (items) std::cout << std::setw(14) << std::setprecision(1) << result.itemsPerSecond / 1e6 << "M/s";
+                    std::cout << "\n";
+                    results.push_back(result);
+                    return;
+                }
+
+                // Aim a little past minTime from what this run took, like Google Benchmark
+                double scale = elapsed.count() > 0 ? minTime * 1.4 / elapsed.count() : 10.0;
+                iterations = std::max(iterations + 1, (uint64_t)(iterations * std::min(scale, 10.0)));
+            }
+        }
+
+        // Google Benchmark's JSON layout, so its compare.py and existing dashboards can read it
+        bool writeJSON(const std::string& path) const {
+            std::ofstream out(path, std::ios::out | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Problem writing " << path << "\n";
+                return false;
+            }
+
+            std::time_t now = std::time(nullptr);
+            char date[32];
+            std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+            out << "{\n  \"context\": {\n"
+                << "    \"date\": \"" << date << "\",\n"
+                << "    \"executable\": \"chip8_bench\",\n"
+                << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+                << "    \"computed_goto\": " << (CHIP8_COMPUTED_GOTO ? "true" : "false") << ",\n"
+                << "    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [";
+            for (size_t i = 0; i < results.size(); i++) {
+                const BenchResult& result = results[i];
+                out << (i ? ",\n" : "\n") << std::setprecision(4) << std::fixed
+                    << "    {\n      \"name\": \"" << result.name << "\",\n"
+                    << "      \"run_name\": \"" << result.name << "\",\n"
+                    << "      \"run_type\": \"iteration\",\n"
+                    << "      \"iterations\": " << result.iterations << ",\n"
+                    << "      \"real_time\": " << result.realNanoseconds << ",\n"
+                    << "      \"cpu_time\": " << result.cpuNanoseconds << ",\n"
+                    << "      \"time_unit\": \"ns\"";
+                if (result.itemsPerSecond > 0) out << ",\n      \"items_per_second\": " << std::setprecision(0) << result.itemsPerSecond;
+                out << "\n    }";
+            }
+            out << "\n  ]\n}\n";
+            return out.good();
+        }
+};
+
+// Reads the per-benchmark results of an earlier --json run (only the fields compareBaseline() needs)
+std::map<std::string, BenchResult> loadBaseline(const std::string& path) {
+    std::map<std::string, BenchResult> baseline;
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Problem reading baseline " << path << "\n";
+        return baseline;
+    }
+
+    // writeJSON() puts one field per line, which is also how Google Benchmark writes its own
+    std::string line, name;
+    auto value = [&](const char* key, std::string& text) {
+        size_t at = line.find(std::string("\"") + key + "\": ");
+        if (at == std::string::npos) return false;
+        text = line.substr(at + std::strlen(key) + 4);
+        if (!text.empty() && text.back() == ',') text.pop_back();
+        return true;
+    };
+    while (std::getline(in, line)) {
+        std::string text;
+        if (value("name", text) && text.size() >= 2) {
+            name = text.substr(1, text.size() - 2);
+            baseline[name].name = name;
+        } else if (!name.empty() && value("real_time", text)) {
+            baseline[name].realNanoseconds = std::stod(text);
+        } else if (!name.empty() && value("items_per_second", text)) {
+            baseline[name].itemsPerSecond = std::stod(text);
+        }
+    }
+    return baseline;
+}
+
+// Flags every benchmark more than 'tolerance' (a fraction) slower than in 'baseline': lower items/s, or
+// longer iterations for the ones without items. Returns false if any is
+bool compareBaseline(const std::vector<BenchResult>& results, const std::map<std::string, BenchResult>& baseline, double tolerance) {
+    bool withinTolerance = true;
+    int compared = 0;
+    std::cout << "\n" << std::left << std::setw(44) << "Compared to baseline" << std::right << std::setw(14) << "baseline"
+              << std::setw(14) << "now" << std::setw(10) << "change" << "\n";
+    for (const BenchResult& result : results) {
+        auto found = baseline.find(result.name);
+        if (found == baseline.end()) continue;
+        const BenchResult& before = found->second;
+
+        bool items = result.itemsPerSecond > 0 && before.itemsPerSecond > 0;
+        double then = items ? before.itemsPerSecond / 1e6 : before.realNanoseconds;
+        double now = items ? result.itemsPerSecond / 1e6 : result.realNanoseconds;
+        if (then <= 0) continue;
+        double speed = items ? now / then : then / now;     // above 1 is faster either way
+        bool regressed = speed < 1.0 - tolerance;
+        compared++;
+
+        std::cout << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << then << std::setw(14) << now << std::setw(9) << std::showpos << (speed - 1.0) * 100.0
+                  << std::noshowpos << "%" << (items ? "  M/s" : "  ns/iter") << (regressed ? "   REGRESSION" : "") << "\n";
+        withinTolerance = withinTolerance && !regressed;
+    }
+    if (compared == 0) {
+        std::cout << "No benchmark in common with the baseline\n";
+    }
+    return withinTolerance;
+}
+
+// Executes up to 'count' instructions through the same dispatch runFrame uses, stops early if the program ends
+uint64_t runInstructions(Chip8& chip8, uint64_t count) {
+    uint64_t executed = 0;
+    while (executed < count && chip8.hasMoreOpcodes()) {
+        int batch = (int)std::min<uint64_t>(count - executed, 1 << 20);
+#if CHIP8_COMPUTED_GOTO
+        executed += chip8.executeThreaded(batch);
+#else
+        for (int i = 0; i < batch && chip8.hasMoreOpcodes(); i++, executed++) chip8.decodeNextOpCode();
+#endif
+    }
+    return executed;
+}
+
+// Boots a machine on 'pattern' repeated to fill 1KB of program memory, followed by a jump back to 0x200
+Chip8 loopProgram(const std::vector<uint16_t>& pattern) {
+    Chip8 chip8;
+    chip8.loadFontset();
+    uint16_t address = 0x200;
+    while (address + 2 * pattern.size() <= 0x600) {
+        for (uint16_t opcode : pattern) {
+            chip8.memory[address] = opcode >> 8;
+            chip8.memory[address + 1] = opcode & 0xFF;
+            address += 2;
+        }
+    }
+    chip8.memory[address] = 0x12;
+    chip8.memory[address + 1] = 0x00;
+    chip8.romSize = address + 2 - 0x200;
+    chip8.invalidateDecodeCache();
+    return chip8;
+}
+
+void dispatchBenchmarks(BenchSuite& suite) {
+    struct Family {
+        const char* name;
+        std::vector<uint16_t> pattern;
+    };
+    // Families group opcodes sharing a handler shape; memory writes go to 0xE00, well past the program
+    const Family families[] = {
+        {"load/6XNN_7XNN", {0x6012, 0x7101, 0x6234, 0x7301}},
+        {"alu/8XY0-8XY7", {0x8010, 0x8121, 0x8232, 0x8343, 0x8454, 0x8565, 0x8676, 0x8787}},
+        {"alu/8XY4_carry", {0x60FF, 0x61FF, 0x8014, 0x8124}},
+        {"shift/8XY6_8XYE", {0x6055, 0x8006, 0x810E}},
+        {"skip/3XNN_4XNN_5XY0_9XY0", {0x3001, 0x4000, 0x5010, 0x9000}},
+        {"jump/1NNN", {}},
+        {"call/2NNN_00EE", {}},
+        {"index/ANNN_FX1E", {0xA300, 0xF01E}},
+        {"memory/FX55_FX65", {0xAE00, 0xF355, 0xF365}},
+        {"memory/FX33", {0xAE00, 0x60C8, 0xF033}},
+        {"timers/FX15_FX07_FX18", {0xF015, 0xF107, 0xF018}},
+        {"font/FX29", {0xF029, 0xF129}},
+        {"random/CXNN", {0xC0FF, 0xC10F}},
+        {"clear/00E0", {0x00E0}},
+        {"key/EX9E_EXA1", {0xE09E, 0xE1A1, 0x6000}},
+    };
+
+    for (const Family& family : families) {
+        Chip8 boot;
+        if (std::string(family.name) == "jump/1NNN") {
+            // Every instruction jumps to the next one
+            std::vector<uint16_t> chain;
+            for (uint16_t address = 0x202; address < 0x600; address += 2) chain.push_back(0x1000 | address);
+            boot = loopProgram(chain);
+        } else if (std::string(family.name) == "call/2NNN_00EE") {
+            // Call a subroutine that returns straight away, then loop
+            boot = loopProgram({0x2206, 0x1200, 0x0000, 0x00EE});
+        } else {
+            boot = loopProgram(family.pattern);
+        }
+
+        Chip8 chip8 = boot;
+        suite.run("BM_Dispatch/" + std::string(family.name), [&](uint64_t iterations) {
+            return runInstructions(chip8, iterations);
+        });
+    }
+}
+
+// Times DXYN of a 'height' row sprite drawn at (x, y) on a 'Machine'
+template <typename Machine>
+void drawBenchmark(BenchSuite& suite, const std::string& name, int height, uint8_t x, uint8_t y) {
+    std::unique_ptr<Machine> chip8(new Machine());
+    chip8->loadFontset();
+    for (int i = 0; i < 15; i++) chip8->memory[0x300 + i] = 0xA5 ^ (i * 0x1F);
+    chip8->I = 0x300;
+    chip8->registers[0] = x;
+    chip8->registers[1] = y;
+
+    suite.run(name, [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            chip8->drewThisFrame = false;    // time the draw, not the VIP display wait
+            chip8->drawOnScreen(0, 1, height);
+        }
+        return iterations;
+    });
+}
+
+void drawBenchmarks(BenchSuite& suite) {
+    // The vip profile clips, so the sprite in the bottom right corner only wraps both ways with xochip quirks
+    using WrappingChip8 = BasicChip8<ClassicModel, XOChipQuirks>;
+    for (int height : {1, 5, 8, 15}) {
+        const std::string prefix = "BM_DXYN/height:" + std::to_string(height);
+        drawBenchmark<Chip8>(suite, prefix + "/wrap:0", height, 13, 9);           // unaligned inside the screen
+        drawBenchmark<WrappingChip8>(suite, prefix + "/wrap:1", height, 60, 28);
+        drawBenchmark<Chip8>(suite, prefix + "/clip:1", height, 60, 28);
+    }
+}
+
+// The 128x64 display of the extended models: 16x16 sprites, sprites on two planes and the scrolls
+void displayBenchmarks(BenchSuite& suite) {
+    SuperChip8 schip;
+    schip.loadFontset();
+    schip.setHighResolution(true);
+    for (int i = 0; i < 64; i++) schip.memory[0x300 + i] = 0xA5 ^ (i * 0x1F);
+    schip.I = 0x300;
+    schip.registers[0] = 121;     // wraps at the right edge, rows are two words
+    schip.registers[1] = 9;
+
+    suite.run("BM_Display/schip/DXY0", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) schip.drawOnScreen(0, 1, 0);
+        return iterations;
+    });
+    suite.run("BM_Display/schip/DXY8_lores", [&](uint64_t iterations) {
+        schip.setHighResolution(false);
+        for (uint64_t i = 0; i < iterations; i++) schip.drawOnScreen(0, 1, 8);
+        schip.setHighResolution(true);
+        return iterations;
+    });
+    suite.run("BM_Display/schip/00FB", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) schip.scrollRight();
+        return iterations;
+    });
+    suite.run("BM_Display/schip/00C4", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) schip.scrollDown(4);
+        return iterations;
+    });
+
+    XOChip8 xochip;
+    xochip.loadFontset();
+    xochip.setHighResolution(true);
+    xochip.selectPlanes(3);
+    for (int i = 0; i < 64; i++) xochip.memory[0x300 + i] = 0x5A ^ (i * 0x1F);
+    xochip.I = 0x300;
+    xochip.registers[0] = 121;
+    xochip.registers[1] = 9;
+
+    suite.run("BM_Display/xochip/DXY0_2planes", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) xochip.drawOnScreen(0, 1, 0);
+        return iterations;
+    });
+    suite.run("BM_Display/xochip/00D4_2planes", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) xochip.scrollUp(4);
+        return iterations;
+    });
+}
+
+void romBenchmarks(BenchSuite& suite, const std::vector<std::string>& roms, int cyclesPerFrame) {
+    for (const std::string& rom : roms) {
+        Chip8 boot;
+        boot.loadFontset();
+        if (!boot.loadROM(rom)) continue;
+
+        // One iteration is one emulated frame, ROMs that run off their end start over
+        Chip8 chip8 = boot;
+        suite.run("BM_ROM/" + std::filesystem::path(rom).filename().string(), [&](uint64_t iterations) {
+            uint64_t instructions = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                uint64_t before = chip8.cycleCount;
+                chip8.runFrame(cyclesPerFrame);
+                instructions += chip8.cycleCount - before;
+                if (!chip8.hasMoreOpcodes()) chip8 = boot;
+            }
+            return instructions;
+        });
+    }
+}
+
+// One iteration is one emulated frame on every lane, items are instructions summed over the lanes
+void lockstepBenchmarks(BenchSuite& suite, const std::vector<std::string>& roms, int cyclesPerFrame) {
+    std::unique_ptr<LockstepChip8> lockstep(new LockstepChip8());
+    std::vector<Chip8> lanes(LockstepChip8::LANES);
+    for (const std::string& rom : roms) {
+        if (!bootLanes(rom, *lockstep, lanes.data())) continue;
+
+        suite.run("BM_Lockstep/" + std::filesystem::path(rom).filename().string(), [&](uint64_t iterations) {
+            uint64_t instructions = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                uint64_t before = 0, after = 0;
+                for (int lane = 0; lane < LockstepChip8::LANES; lane++) before += lockstep->machine(lane).cycleCount;
+                lockstep->runFrame(cyclesPerFrame);
+                for (int lane = 0; lane < LockstepChip8::LANES; lane++) after += lockstep->machine(lane).cycleCount;
+                instructions += after - before;
+                if (after == before) bootLanes(rom, *lockstep, lanes.data());    // every lane ran off the ROM, start over
+            }
+            return instructions;
+        });
+    }
+}
+
+// One iteration is one golden run from boot, items are the frames it emulated. Not instructions: the
+// cycle count includes whatever skipIdle() fast-forwarded, which is most of it for ROMs waiting on a key
+void conformanceBenchmarks(BenchSuite& suite, const std::string& romDir) {
+    for (const GoldenFrame& golden : GOLDEN) {
+        std::string path = (std::filesystem::path(romDir) / golden.rom).string();
+        if (!std::filesystem::exists(path)) continue;
+
+        withGoldenBoot(path, golden, [&](const auto& boot) {
+            suite.run("BM_Conformance/" + goldenName(golden), [&](uint64_t iterations) {
+                uint64_t frames = 0;
+                for (uint64_t i = 0; i < iterations; i++) {
+                    auto chip8 = boot;
+                    runGoldenFrames(chip8, false);
+                    frames += chip8.frameCount;
+                }
+                return frames;
+            });
+        });
+    }
+}
+
+// Starting a batch instance: booting from the file as a single run does, against copying the cached image
+void bootBenchmarks(BenchSuite& suite, const std::vector<std::string>& roms) {
+    RomCache cache;
+    if (roms.empty() || !cache.add(roms.front())) return;
+    const Chip8* image = cache.find(roms.front());
+
+    // Items are instances booted with the cached image's decode, reading the decode cache back
+    // keeps the machines from being optimised away
+    const uint16_t opcode = image->decodeCache[0x100].opcode;
+    suite.run("BM_Boot/loadROM", [&](uint64_t iterations) {
+        uint64_t booted = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            Chip8 chip8;
+            chip8.loadFontset();
+            chip8.loadROM(roms.front());
+            chip8.seedRandom(i);
+            booted += chip8.decodeCache[0x100].opcode == opcode;
+        }
+        return booted;
+    });
+    std::unique_ptr<Chip8> chip8(new Chip8());
+    suite.run("BM_Boot/image", [&](uint64_t iterations) {
+        uint64_t booted = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            *chip8 = *image;
+            chip8->seedRandom(i);
+            booted += chip8->decodeCache[0x100].opcode == opcode;
+        }
+        return booted;
+    });
+}
+
+void snapshotBenchmarks(BenchSuite& suite, const std::vector<std::string>& roms) {
+    Chip8 chip8;
+    chip8.loadFontset();
+    if (!roms.empty()) chip8.loadROM(roms.front());
+    chip8.runFrame(1000);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "chip8_bench.state").string();
+    if (!saveSnapshot(path, chip8)) return;
+    suite.run("BM_Snapshot/save", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) saveSnapshot(path, chip8);
+        return uint64_t(0);
+    });
+
+    MappedSnapshots snapshots;
+    Chip8 restored;
+    snapshots.open(path);
+    suite.run("BM_Snapshot/restore", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) snapshots.restore(0, restored);
+        return uint64_t(0);
+    });
+    snapshots.close();
+
+    suite.run("BM_Snapshot/open_and_restore", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) loadSnapshot(path, restored);
+        return uint64_t(0);
+    });
+    std::filesystem::remove(path);
+
+    // Rewind history: one delta-compressed record per frame, and stepping back through them
+    RewindBuffer rewind(64 << 20);
+    Chip8 running = chip8;
+    suite.run("BM_Rewind/record", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            running.runFrame(8);
+            rewind.record(running);
+        }
+        return uint64_t(0);
+    });
+    suite.run("BM_Rewind/stepBack", [&](uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; i++) {
+            if (!rewind.stepBack(running)) rewind.record(running);   // ran out of history, keep the buffer non-empty
+        }
+        return uint64_t(0);
+    });
+}
+
+int main(int argc, char *argv[]) {
+    std::string romDir = "assets/ROMS";
+    uint64_t frames = 200000;     // per ROM and mode
+    int cyclesPerFrame = 100;
+    std::string jsonPath;         // --json PATH: also write the suite results as JSON
+    std::string baselinePath;     // --baseline PATH: fail on suite results slower than in this --json output
+    double tolerance = 0.10;      // --tolerance PERCENT: how much slower counts as a regression
+    bool compare = true;          // --suite-only skips the dispatch comparison
+    bool conformanceOnly = false; // --conformance: only the golden frames and their benchmarks
+    BenchSuite suite;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        } else if (arg == "--roms" && i + 1 < argc) {
+            romDir = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            suite.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            suite.minTime = std::stod(argv[++i]);
+        } else if (arg == "--suite-only") {
+            compare = false;
+        } else if (arg == "--conformance") {
+            conformanceOnly = true;
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]) / 100.0;
+        } else {
+            std::cerr << "Usage: chip8_bench [--frames N] [--roms DIR] [--json PATH] [--filter TEXT] [--min-time SECONDS] [--suite-only]\n"
+                      << "                   [--conformance] [--baseline PATH] [--tolerance PERCENT]\n";
+            return 2;
+        }
+    }
+
+    std::vector<std::string> roms;
+    for (const auto& entry : std::filesystem::directory_iterator(romDir)) {
+        if (entry.is_regular_file()) roms.push_back(entry.path().string());
+    }
+    std::sort(roms.begin(), roms.end());
+
+    // Read up front, so a bad path fails before the benchmarks rather than after
+    std::map<std::string, BenchResult> baseline;
+    if (!baselinePath.empty()) {
+        baseline = loadBaseline(baselinePath);
+        if (baseline.empty()) return 2;
+    }
+
+    bool allMatch = true;
+    if (compare && !conformanceOnly) {
+        allMatch = compareDispatch(roms, frames, cyclesPerFrame) && allMatch;
+        allMatch = compareLockstep(roms, frames, cyclesPerFrame) && allMatch;
+    }
+    allMatch = (compare ? checkGoldenFrames(romDir) : true) && allMatch;
+    allMatch = (compare ? checkChip48Quirks() : true) && allMatch;
+    allMatch = (compare ? checkRplFlags() : true) && allMatch;
+    allMatch = (compare ? checkStackFaults() : true) && allMatch;
+
+    std::cout << "\n" << std::left << std::setw(44) << "Benchmark" << std::right << std::setw(14) << "ns/iter" << std::setw(14) << "iterations"
+              << std::setw(17) << "items/s" << "\n";
+    if (!conformanceOnly) {
+        dispatchBenchmarks(suite);
+        drawBenchmarks(suite);
+        displayBenchmarks(suite);
+        romBenchmarks(suite, roms, cyclesPerFrame);
+        lockstepBenchmarks(suite, roms, cyclesPerFrame);
+        bootBenchmarks(suite, roms);
+        snapshotBenchmarks(suite, roms);
+    }
+    conformanceBenchmarks(suite, romDir);
+
+    if (!jsonPath.empty() && suite.writeJSON(jsonPath)) {
+        std::cout << "Results written to " << jsonPath << "\n";
+    }
+    bool fastEnough = baselinePath.empty() || compareBaseline(suite.results, baseline, tolerance);
+
+    return allMatch && fastEnough ? 0 : 1;
+}
+
@@ -0,0 +1,349 @@
+#ifndef CAPTURE_CPP
+#define CAPTURE_CPP
+
+#include "capture.h"
+#include "framebuffer.cpp"
+#include "pipeline.cpp"
+
+// Headless video export: every frame that changed the display, either as numbered PBM/PGM/PNG
+// images or as a raw RGB24 stream for an external encoder, e.g.
+//   chip8_emulator --headless --export - rom | ffmpeg -f rawvideo -pixel_format rgb24 -video_size 64x32 -framerate 60 -i - out.mp4
+// A frame identical to the last one exported is skipped, so a stream has one frame per display change.
+// The emulation thread only compares the display with the last frame it queued and copies it into a
+// bounded queue, a writer thread drains the queue in batches and does all the encoding and file I/O.
+// Pixels go through the same palette expansion as the window, so exports look like what was on screen
+
+enum class CaptureFormat { PBM, PGM, PNG, Raw };
+
+// Images for the .pbm, .pgm and .png extensions, a raw stream to anything else (a file, a FIFO, "-" for stdout)
+inline CaptureFormat captureFormat(const std::string& path) {
+    auto endsWith = [&](const char* extension) {
+        size_t length = std::strlen(extension);
+        return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+    };
+    if (endsWith(".pbm")) return CaptureFormat::PBM;
+    if (endsWith(".pgm")) return CaptureFormat::PGM;
+    if (endsWith(".png")) return CaptureFormat::PNG;
+    return CaptureFormat::Raw;
+}
+
+// The real stdout, for a raw stream written to "-". The first call duplicates it and points
+// descriptor 1 at stderr so the emulator's own messages can't end up in the video, call it before
+// anything is printed
+inline int rawStdout() {
+    static const int fd = [] {
+        std::cout.flush();
+        int duplicate = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        return duplicate;
+    }();
+    return fd;
+}
+
+// CRC-32 of PNG chunks (polynomial 0xEDB88320)
+inline uint32_t pngCrc(const uint8_t* data, size_t size, uint32_t crc = 0xFFFFFFFF) {
+    static const auto table = [] {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int bit = 0; bit < 8; bit++) {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+inline void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+inline void pngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    putBigEndian(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, pngCrc(out.data() + start, out.size() - start) ^ 0xFFFFFFFF);
+}
+
+// 8-bit RGB PNG of 'rgb' (width * height * 3 bytes). The image data is zlib in stored (uncompressed)
+// blocks: a display is a few KB at most, not worth pulling in a deflate implementation for
+inline void encodePNG(std::vector<uint8_t>& out, const uint8_t* rgb, int width, int height) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});   // 8 bits per channel, RGB, deflate, no filter, no interlace
+    pngChunk(out, "IHDR", header);
+
+    // Every scanline starts with its filter type, 0 (none)
+    std::vector<uint8_t> raw;
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + (size_t)y * width * 3, rgb + (size_t)(y + 1) * width * 3);
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+        size_t length = std::min<size_t>(raw.size() - offset, 65535);
+        zlib.push_back(offset + length == raw.size());
+        zlib.insert(zlib.end(), {uint8_t(length), uint8_t(length >> 8), uint8_t(~length), uint8_t(~length >> 8)});
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(zlib, (b << 16) | a);
+    pngChunk(out, "IDAT", zlib);
+    pngChunk(out, "IEND", {});
+}
+
+class FrameCapture {
+    public:
+        FrameCapture() = default;
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        ~FrameCapture() {
+            close();
+        }
+
+        // Starts exporting to 'path' (see captureFormat()), with the current display of 'chip8' as
+        // the first frame. A full queue drops the frame, unless 'lossless': then the emulation thread
+        // waits for the writer, which is what an unthrottled run only producing output wants
+        template <typename Machine>
+        bool open(const std::string& path, const Machine& chip8, const Palette& colours, bool lossless) {
+            this->path = path;
+            format = captureFormat(path);
+            palette = colours;
+            waitWhenFull = lossless;
+            width = Machine::Display::WIDTH;
+            height = Machine::Display::HEIGHT;
+            planes = Machine::Display::PLANES;
+
+            if (format == CaptureFormat::Raw) {
+                // Opening a FIFO waits here until the encoder has opened the other end
+                fd = path == "-" ? rawStdout() : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0) {
+                    std::cerr << "Problem writing " << path << ": " << std::strerror(errno) << "\n";
+                    return false;
+                }
+                std::signal(SIGPIPE, SIG_IGN);   // an encoder that goes away is a write error, not the end of the process
+            } else {
+                size_t slash = path.rfind('/');
+                std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+                if (access(directory.c_str(), W_OK) != 0) {
+                    std::cerr << "Problem writing to " << directory << ": " << std::strerror(errno) << "\n";
+                    return false;
+                }
+            }
+
+            queue.reset(new SpscQueue<VideoFrame, QUEUE_FRAMES>());
+            stopping = false;
+            error.clear();
+            framesWritten = framesDropped = 0;
+            lastQueued = false;
+            writer = std::thread(&FrameCapture::run, this);
+            frame(chip8);
+            return true;
+        }
+
+        bool isOpen() const {
+            return writer.joinable();
+        }
+
+        // Call after a frame that changed the display, queues it unless it looks like the last one queued
+        template <typename Machine>
+        void frame(const Machine& chip8) {
+            constexpr int WORDS = Machine::Display::WORDS;
+            if (lastQueued && std::equal(chip8.gfx, chip8.gfx + WORDS, last.rows)) {
+                return;
+            }
+            std::copy_n(chip8.gfx, WORDS, last.rows);
+            last.frame = chip8.frameCount;
+            last.width = width;
+            last.height = height;
+            last.planes = planes;
+
+            lastQueued = queue->push(last);
+            while (!lastQueued && waitWhenFull) {
+                std::this_thread::yield();
+                lastQueued = queue->push(last);
+            }
+            if (!lastQueued) {
+                framesDropped++;
+                return;
+            }
+            { std::lock_guard<std::mutex> lock(mutex); }   // the writer is either waiting already or yet to look at the queue
+            wakeup.notify_one();
+        }
+
+        // Writes out what is still queued and stops the writer, returns false if anything failed
+        bool close() {
+            if (!writer.joinable()) {
+                return error.empty();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            writer.join();
+            if (fd >= 0 && path != "-") {
+                ::close(fd);
+            }
+            fd = -1;
+            if (!error.empty()) {
+                std::cerr << error << "\n";
+            }
+            return error.empty();
+        }
+
+        uint64_t written() const { return framesWritten; }
+        uint64_t dropped() const { return framesDropped; }
+
+    private:
+        static constexpr size_t QUEUE_FRAMES = 256;    // about 4s of a display changing every 60Hz frame
+
+        std::string path;
+        CaptureFormat format = CaptureFormat::Raw;
+        Palette palette;
+        bool waitWhenFull = false;
+        int width = 64;
+        int height = 32;
+        int planes = 1;
+        int fd = -1;
+
+        std::unique_ptr<SpscQueue<VideoFrame, QUEUE_FRAMES>> queue;
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool stopping = false;          // guarded by 'mutex'
+        std::string error;              // first write error, set by the writer
+        uint64_t framesWritten = 0;     // writer side, read after join()
+        uint64_t framesDropped = 0;     // emulation side
+
+        VideoFrame last;                // copy of the display last queued
+        bool lastQueued = false;
+
+        // Writer thread: everything queued since it last looked is one batch, a raw stream goes out
+        // in a single write per batch
+        void run() {
+            VideoFrame item;
+            std::vector<uint32_t> pixels;
+            std::vector<uint8_t> rgb;
+            std::vector<uint8_t> batch;
+            while (true) {
+                bool stop;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeup.wait(lock, [&] { return stopping || !queue->empty(); });
+                    stop = stopping;
+                }
+
+                uint64_t batchFrames = 0;
+                while (queue->pop(item)) {
+                    if (!error.empty()) continue;   // keep draining, the emulation side never finds out
+                    expand(item, pixels, rgb);
+                    if (format == CaptureFormat::Raw) {
+                        batch.insert(batch.end(), rgb.begin(), rgb.end());
+                        batchFrames++;
+                    } else if (writeImage(item.frame, rgb)) {
+                        framesWritten++;
+                    }
+                }
+                if (!batch.empty()) {
+                    if (writeAll(batch.data(), batch.size())) framesWritten += batchFrames;
+                    batch.clear();
+                }
+                if (stop && queue->empty()) {
+                    return;
+                }
+            }
+        }
+
+        // RGB24 of a frame as the window would show it
+        void expand(const VideoFrame& item, std::vector<uint32_t>& pixels, std::vector<uint8_t>& rgb) const {
+            pixels.resize((size_t)item.width * item.height);
+            if (item.planes == 1) {
+                // a 128 pixel row is two consecutive 64 pixel words
+                expandFramebuffer(item.rows, 0, item.height * item.width / 64 - 1, pixels.data(), 64, palette);
+            } else {
+                expandPlanes(item.rows, item.width, item.height, item.planes, 0, item.height - 1, pixels.data(), palette);
+            }
+            rgb.resize(pixels.size() * 3);
+            for (size_t i = 0; i < pixels.size(); i++) {
+                rgb[i * 3] = pixels[i] >> 24;
+                rgb[i * 3 + 1] = pixels[i] >> 16;
+                rgb[i * 3 + 2] = pixels[i] >> 8;
+            }
+        }
+
+        // PREFIX.EXT becomes PREFIX-<frame>.EXT, zero padded so the files sort in order
+        bool writeImage(uint64_t frameNumber, const std::vector<uint8_t>& rgb) {
+            size_t dot = path.rfind('.');
+            char number[24];
+            std::snprintf(number, sizeof(number), "-%06llu", (unsigned long long)frameNumber);
+            std::string name = path.substr(0, dot) + number + path.substr(dot);
+
+            std::vector<uint8_t> image;
+            const size_t count = rgb.size() / 3;
+            auto luma = [&](size_t i) {
+                return static_cast<uint8_t>((rgb[i * 3] * 299 + rgb[i * 3 + 1] * 587 + rgb[i * 3 + 2] * 114) / 1000);
+            };
+            if (format == CaptureFormat::PBM) {
+                // 1 is black, a pixel is black when it's dark in the palette
+                std::string header = "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n";
+                image.assign(header.begin(), header.end());
+                image.resize(image.size() + count / 8);
+                uint8_t* bits = image.data() + header.size();
+                for (size_t i = 0; i < count; i++) {
+                    bits[i / 8] |= (luma(i) < 128) << (7 - i % 8);
+                }
+            } else if (format == CaptureFormat::PGM) {
+                std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+                image.assign(header.begin(), header.end());
+                for (size_t i = 0; i < count; i++) {
+                    image.push_back(luma(i));
+                }
+            } else {
+                encodePNG(image, rgb.data(), width, height);
+            }
+
+            std::ofstream out(name, std::ios::out | std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(image.data()), image.size());
+            out.close();
+            if (out.fail()) {
+                error = "Problem writing " + name;
+                return false;
+            }
+            return true;
+        }
+
+        bool writeAll(const uint8_t* data, size_t size) {
+            while (size > 0) {
+                ssize_t done = ::write(fd, data, size);
+                if (done < 0 && errno == EINTR) continue;
+                if (done <= 0) {
+                    error = "Problem writing " + path + ": " + std::strerror(errno);
+                    return false;
+                }
+                data += done;
+                size -= done;
+            }
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
@@ -1,40 +1,440 @@
+#ifndef CHIP8_CPP
+#define CHIP8_CPP
+
 #include "chip8.h"
+#include "display.h"
+#include "display.cpp"
+
+// Operand fields of an opcode
+constexpr uint8_t opX(uint16_t opcode) { return (opcode & 0x0F00) >> 8; }
+constexpr uint8_t opY(uint16_t opcode) { return (opcode & 0x00F0) >> 4; }
+constexpr uint8_t opN(uint16_t opcode) { return opcode & 0x000F; }
+constexpr uint8_t opNN(uint16_t opcode) { return opcode & 0x00FF; }
+constexpr uint16_t opNNN(uint16_t opcode) { return opcode & 0x0FFF; }
+
+// Every instruction the interpreter knows about, as X(name, body).
+// 'self' is the Chip8 instance and 'opcode' the raw 16-bit opcode, this single list generates the
+// opcode classes, their printable names, the function-pointer handlers and the computed-goto labels.
+// The SUPER-CHIP and XO-CHIP instructions at the end are ignored, like any undefined opcode, by models without them
+#define CHIP8_OPCODES(X) \
+    X(NONE, (void)self) /* 0000, 0NNN and undefined opcodes are ignored */ \
+    X(00E0, self.clearScreen()) \
+    X(00EE, self.returnFromSubroutine()) \
+    X(1NNN, self.jump(opNNN(opcode))) \
+    X(2NNN, self.callSubroutine(opNNN(opcode))) \
+    X(3XNN, self.skipNextInstructionValueEq(opX(opcode), opNN(opcode))) \
+    X(4XNN, self.skipNextInstructionValueDiff(opX(opcode), opNN(opcode))) \
+    X(5XY0, self.skipNextInstructionRgister(opX(opcode), opY(opcode))) \
+    X(6XNN, self.setRegisterVc(opX(opcode), opNN(opcode))) \
+    X(7XNN, self.addToRegister(opX(opcode), opNN(opcode))) \
+    X(8XY0, self.copyRegister(opX(opcode), opY(opcode))) \
+    X(8XY1, self.bitwiseOR(opX(opcode), opY(opcode))) \
+    X(8XY2, self.bitwiseAND(opX(opcode), opY(opcode))) \
+    X(8XY3, self.bitwiseXOR(opX(opcode), opY(opcode))) \
+    X(8XY4, self.registersADD(opX(opcode), opY(opcode))) \
+    X(8XY5, self.registersSUB(opX(opcode), opY(opcode))) \
+    X(8XY6, self.registersSHR(opX(opcode), opY(opcode))) \
+    X(8XY7, self.registersSUBN(opX(opcode), opY(opcode))) \
+    X(8XYE, self.registersSHL(opX(opcode), opY(opcode))) \
+    X(9XY0, self.skipNextInstruction(opX(opcode), opY(opcode))) \
+    X(ANNN, self.setIndexRegister(opNNN(opcode))) \
+    X(BNNN, self.jumpWithV0(opNNN(opcode))) \
+    X(CXNN, self.randomByteAnd(opX(opcode), opNN(opcode))) \
+    X(DXYN, self.drawOnScreen(opX(opcode), opY(opcode), opN(opcode))) \
+    X(EX9E, self.skipNextInstructionIfKeyPressed(opX(opcode))) \
+    X(EXA1, self.skipNextInstructionIfKeyNotPressed(opX(opcode))) \
+    X(FX07, self.storeDelayTimer(opX(opcode))) \
+    X(FX0A, self.waitForKeyPress(opX(opcode))) \
+    X(FX15, self.setDelayTimer(opX(opcode))) \
+    X(FX18, self.setSoundTimer(opX(opcode))) \
+    X(FX1E, self.updateIndex(opX(opcode))) \
+    X(FX29, self.setIToDigitSprite(opX(opcode))) \
+    X(FX33, self.storeBCDRepresentation(opX(opcode))) \
+    X(FX55, self.assignToMemory(opX(opcode))) \
+    X(FX65, self.assignToRegisters(opX(opcode))) \
+    X(00CN, self.scrollDown(opN(opcode))) \
+    X(00DN, self.scrollUp(opN(opcode))) \
+    X(00FB, self.scrollRight()) \
+    X(00FC, self.scrollLeft()) \
+    X(00FD, self.exitInterpreter()) \
+    X(00FE, self.setHighResolution(false)) \
+    X(00FF, self.setHighResolution(true)) \
+    X(5XY2, self.storeRegisterRange(opX(opcode), opY(opcode))) \
+    X(5XY3, self.loadRegisterRange(opX(opcode), opY(opcode))) \
+    X(F000, self.setIndexLong()) \
+    X(FN01, self.selectPlanes(opX(opcode))) \
+    X(F002, self.loadAudioPattern()) \
+    X(FX30, self.setIToBigDigitSprite(opX(opcode))) \
+    X(FX3A, self.setPitch(opX(opcode))) \
+    X(FX75, self.saveFlags(opX(opcode))) \
+    X(FX85, self.loadFlags(opX(opcode)))
+
+// Opcode classes, OP_00E0, OP_DXYN, ...
+enum OpClass : uint8_t {
+#define CHIP8_OPCODE_ENUM(name, body) OP_##name,
+    CHIP8_OPCODES(CHIP8_OPCODE_ENUM)
+#undef CHIP8_OPCODE_ENUM
+    OP_COUNT
+};
+
+// Printable name of each opcode class
+inline constexpr const char* opClassNames[OP_COUNT] = {
+#define CHIP8_OPCODE_NAME(name, body) #name,
+    CHIP8_OPCODES(CHIP8_OPCODE_NAME)
+#undef CHIP8_OPCODE_NAME
+};
+
+// Same decision tree decodeNextOpCodeSwitch() walks, evaluated once per possible opcode
+constexpr OpClass classifyOpCode(uint16_t opcode) {
+    switch ((opcode & 0xF000) >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) return OP_00E0;
+            if (opcode == 0x00EE) return OP_00EE;
+            if ((opcode & 0xFFF0) == 0x00C0) return OP_00CN;
+            if ((opcode & 0xFFF0) == 0x00D0) return OP_00DN;
+            if (opcode == 0x00FB) return OP_00FB;
+            if (opcode == 0x00FC) return OP_00FC;
+            if (opcode == 0x00FD) return OP_00FD;
+            if (opcode == 0x00FE) return OP_00FE;
+            if (opcode == 0x00FF) return OP_00FF;
+            return OP_NONE;
+        case 0x1: return OP_1NNN;
+        case 0x2: return OP_2NNN;
+        case 0x3: return OP_3XNN;
+        case 0x4: return OP_4XNN;
+        case 0x5:
+            if (opN(opcode) == 0) return OP_5XY0;
+            if (opN(opcode) == 2) return OP_5XY2;
+            if (opN(opcode) == 3) return OP_5XY3;
+            return OP_NONE;
+        case 0x6: return OP_6XNN;
+        case 0x7: return OP_7XNN;
+        case 0x8:
+            switch (opN(opcode)) {
+                case 0x0: return OP_8XY0;
+                case 0x1: return OP_8XY1;
+                case 0x2: return OP_8XY2;
+                case 0x3: return OP_8XY3;
+                case 0x4: return OP_8XY4;
+                case 0x5: return OP_8XY5;
+                case 0x6: return OP_8XY6;
+                case 0x7: return OP_8XY7;
+                case 0xE: return OP_8XYE;
+            }
+            return OP_NONE;
+        case 0x9: return opN(opcode) == 0 ? OP_9XY0 : OP_NONE;
+        case 0xA: return OP_ANNN;
+        case 0xB: return OP_BNNN;
+        case 0xC: return OP_CXNN;
+        case 0xD: return OP_DXYN;
+        case 0xE:
+            if (opNN(opcode) == 0x9E) return OP_EX9E;
+            if (opNN(opcode) == 0xA1) return OP_EXA1;
+            return OP_NONE;
+        case 0xF:
+            if (opcode == 0xF000) return OP_F000;
+            if (opcode == 0xF002) return OP_F002;
+            switch (opNN(opcode)) {
+                case 0x01: return OP_FN01;
+                case 0x07: return OP_FX07;
+                case 0x0A: return OP_FX0A;
+                case 0x15: return OP_FX15;
+                case 0x18: return OP_FX18;
+                case 0x1E: return OP_FX1E;
+                case 0x29: return OP_FX29;
+                case 0x33: return OP_FX33;
+                case 0x55: return OP_FX55;
+                case 0x65: return OP_FX65;
+                case 0x30: return OP_FX30;
+                case 0x3A: return OP_FX3A;
+                case 0x75: return OP_FX75;
+                case 0x85: return OP_FX85;
+            }
+            return OP_NONE;
+    }
+    return OP_NONE;
+}
+
+// Opcode -> class lookup for all 64K opcodes, built at compile time.
+// One byte per entry keeps it at 64KB (a table of 8-byte handler pointers would be 512KB),
+// so a dispatch is one load from here plus one indirect jump
+struct OpClassTable {
+    uint8_t entries[65536] = {0};
 
-class Chip8 {
+    constexpr OpClassTable() {
+        for (uint32_t opcode = 0; opcode < 65536; opcode++) {
+            entries[opcode] = classifyOpCode(opcode);
+        }
+    }
+};
+
+inline constexpr OpClassTable opClassTable{};
+
+// Pre-decoded instruction, the operands are read straight out of 'opcode' by the handlers
+struct DecodedOp {
+    uint16_t opcode;
+    uint8_t opClass;
+};
+
+// GCC/Clang computed-goto threading in runFrame(), build with -DCHIP8_NO_COMPUTED_GOTO to fall back to the handler table
+#if defined(__GNUC__) && !defined(CHIP8_NO_COMPUTED_GOTO)
+#define CHIP8_COMPUTED_GOTO 1
+#else
+#define CHIP8_COMPUTED_GOTO 0
+#endif
+
+// Profiling hooks, they compile to nothing unless built with -DCHIP8_PROFILE
+#ifdef CHIP8_PROFILE
+#include "profiler.cpp"
+#define CHIP8_PROFILE_HOOK(call) do { if (activeProfile) activeProfile->call; } while (0)
+#else
+#define CHIP8_PROFILE_HOOK(call) do {} while (0)
+#endif
+
+// Quirk profiles: instructions whose behaviour differs between implementations. A profile is a
+// compile-time parameter of the interpreter like the model, every check below folds away and each
+// profile gets its own specialized handlers
+enum class IndexIncrement { None, X, XPlusOne };
+
+struct CosmacVipQuirks {
+    static constexpr const char* NAME = "vip";
+    static constexpr bool VF_RESET = true;        // 8XY1/8XY2/8XY3 clear VF
+    static constexpr IndexIncrement MEMORY = IndexIncrement::XPlusOne; // what FX55/FX65 leave in I
+    static constexpr bool DISPLAY_WAIT = true;    // DXYN waits for the next 60Hz frame after a draw
+    static constexpr bool CLIPPING = true;        // sprites are cut off at the screen edges instead of wrapping
+    static constexpr bool SHIFT_VX = false;       // 8XY6/8XYE shift Vx in place instead of shifting Vy into Vx
+    static constexpr bool JUMP_VX = false;        // BXNN jumps to XNN + Vx instead of NNN + V0
+};
+
+struct Chip48Quirks {
+    static constexpr const char* NAME = "chip48";
+    static constexpr bool VF_RESET = false;
+    static constexpr IndexIncrement MEMORY = IndexIncrement::X;
+    static constexpr bool DISPLAY_WAIT = false;
+    static constexpr bool CLIPPING = true;
+    static constexpr bool SHIFT_VX = true;
+    static constexpr bool JUMP_VX = true;
+};
+
+struct SuperChipQuirks {
+    static constexpr const char* NAME = "schip";
+    static constexpr bool VF_RESET = false;
+    static constexpr IndexIncrement MEMORY = IndexIncrement::None;
+    static constexpr bool DISPLAY_WAIT = false;
+    static constexpr bool CLIPPING = true;
+    static constexpr bool SHIFT_VX = true;
+    static constexpr bool JUMP_VX = true;
+};
+
+struct XOChipQuirks {
+    static constexpr const char* NAME = "xochip";
+    static constexpr bool VF_RESET = false;
+    static constexpr IndexIncrement MEMORY = IndexIncrement::XPlusOne;
+    static constexpr bool DISPLAY_WAIT = false;
+    static constexpr bool CLIPPING = false;
+    static constexpr bool SHIFT_VX = false;
+    static constexpr bool JUMP_VX = false;
+};
+
+// Machine models: display size, memory size and instruction set extensions are compile-time
+// parameters of the core, so the classic 64x32 machine carries none of the extended machinery
+struct ClassicModel {
+    static constexpr const char* NAME = "chip8";
+    static constexpr int WIDTH = 64;
+    static constexpr int HEIGHT = 32;
+    static constexpr int PLANES = 1;
+    static constexpr uint32_t MEMORY_SIZE = 4096;
+    static constexpr bool SUPER_CHIP = false;   // 128x64, scrolling, 16x16 sprites, big font, RPL flags
+    static constexpr bool XO_CHIP = false;      // 64KB, bitplanes, audio patterns, F000 NNNN, 5XY2/5XY3, 00DN
+    using Quirks = CosmacVipQuirks;             // profile used unless another one is asked for
+};
+
+struct SuperChipModel {
+    static constexpr const char* NAME = "schip";
+    static constexpr int WIDTH = 128;
+    static constexpr int HEIGHT = 64;
+    static constexpr int PLANES = 1;
+    static constexpr uint32_t MEMORY_SIZE = 4096;
+    static constexpr bool SUPER_CHIP = true;
+    static constexpr bool XO_CHIP = false;
+    using Quirks = SuperChipQuirks;
+};
+
+struct XOChipModel {
+    static constexpr const char* NAME = "xochip";
+    static constexpr int WIDTH = 128;
+    static constexpr int HEIGHT = 64;
+    static constexpr int PLANES = 4;
+    static constexpr uint32_t MEMORY_SIZE = 65536;
+    static constexpr bool SUPER_CHIP = true;
+    static constexpr bool XO_CHIP = true;
+    using Quirks = XOChipQuirks;
+};
+
+// State only the extended models have, CHIP-8 gets the empty base and pays nothing for it
+template <typename Model, bool Extended = Model::SUPER_CHIP>
+struct ExtensionState {};
+
+template <typename Model>
+struct ExtensionState<Model, true> {
+    bool hires = false;                   // 128x64 mode (00FF), otherwise 64x32 pixels drawn as 2x2 (00FE)
+    bool exited = false;                  // 00FD was executed
+    uint8_t planeMask = 1;                // Planes DXYN, 00E0 and the scrolls act on (FN01)
+    uint8_t pitch = 64;                   // Audio pattern rate (FX3A), 4000 * 2^((pitch - 64) / 48) samples/s
+    uint8_t rplFlags[16] = {0};           // FX75 / FX85 storage
+    uint8_t audioPattern[16] = {0};       // 128 1-bit samples loaded by F002
+};
+
+template <typename Model, typename Quirks = typename Model::Quirks>
+class BasicChip8 : public ExtensionState<Model> {
     public:
+        using ModelType = Model;
+        using QuirksType = Quirks;
+        using Display = DisplayEngine<Model::WIDTH, Model::HEIGHT, Model::PLANES>;
+        using RowMask = typename Display::RowMask;
+        static constexpr uint32_t MEMORY_SIZE = Model::MEMORY_SIZE;
+        static constexpr uint16_t ADDRESS_MASK = MEMORY_SIZE - 1;
+        static constexpr uint16_t BIG_FONT_ADDRESS = 0x50;   // FX30 digits, right after the small font
+        static constexpr size_t MAX_ROM_SIZE = MEMORY_SIZE - 0x200;   // ROMs load at 0x200 and must fit below the end of memory
+
         // Memory and registers
-        uint8_t memory[4096] = {0};           // Memory for the Chip-8 system
+        uint8_t memory[MEMORY_SIZE] = {0};    // Memory for the Chip-8 system
         uint8_t registers[16] = {0};          // 16 registers (V0 to VF, hexadecimal)
-        uint8_t delay_timer;                  // Delay timer
-        uint8_t sound_timer;                  // Sound timer
-        uint16_t I;                           // Index register, 16-bit register for memory addresses usually only uses 12 bits because of that
+        uint8_t delay_timer = 0;              // Delay timer
+        uint8_t sound_timer = 0;              // Sound timer
+        uint16_t I = 0;                       // Index register, 16-bit register for memory addresses usually only uses 12 bits because of that
         uint16_t pc = 0x200;                  // Program counter
         size_t romSize = 0;                   // Rom Size
         uint8_t sp = 0;                       // Stack pointer
-        uint16_t stack[16];                   // Stack for storing return addresses
+        uint16_t stack[16] = {0};             // Stack for storing return addresses
         uint8_t keypad[16] = {0};             // Keypad state (0-15), array of 16 keys
-        uint8_t pressedKey = -1;
-        uint8_t gfx[64 * 32] = {0};           // Graphics memory (64x32 pixels)
-        
-        // SDL-specific members
-        SDL_Window* window = nullptr;
-        SDL_Renderer* renderer = nullptr;
-        SDL_Texture* texture = nullptr;
-        uint32_t pixels[64 * 32] = {0};       // RGBA pixel buffer for rendering
-        
-        // Constants for rendering
-        const int PIXEL_SIZE = 10;            // Size of each CHIP-8 pixel
-        const uint32_t ON_COLOR = 0xFFFFFFFF; // White color for ON pixels
-        const uint32_t OFF_COLOR = 0x00000000; // Black color for OFF pixels
+        uint8_t pressedKey = 0xFF;            // Key newly pressed by the last keypad change, 0xFF if none, consumed by Fx0A
+        alignas(64) uint64_t gfx[Display::WORDS] = {0}; // Graphics memory laid out as in DisplayEngine, for CHIP-8 one word per row (64x32 pixels), bit 63 is the leftmost pixel
+        RowMask dirtyRows = 0;                // Bit per display row changed by 00E0/DXYN/scrolls, cleared by whoever presents the frame
+        bool beepFlag = false;                // Set when the sound timer runs out, cleared by whoever plays the sound
+        bool drewThisFrame = false;           // DXYN ran since the last timer tick, with DISPLAY_WAIT the next one stalls until then
+        bool stackFault = false;              // 2NNN with all 15 stack levels in use or 00EE with none, the machine stops there
+        uint64_t cycleCount = 0;              // Instructions executed so far
+        uint64_t frameCount = 0;              // 60Hz frames emulated so far
+        uint32_t randomState = 0x2545F491;    // Per-instance xorshift32 state for CXNN, see seedRandom()
+        DecodedOp decodeCache[MEMORY_SIZE / 2] = {}; // Decoded instruction per even address, kept in sync with memory
+
+        static constexpr int IDLE_CHECK_INTERVAL = 64;  // runFrame() looks for idle loops this often
+
+        // Font set (0 to F), each character is 5 bytes tall
+        // This is not very elegant but this instruction is so boring to code I just want to get it over with
+        static constexpr uint8_t fontset[80] = {
+            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+            0x20, 0x60, 0x20, 0x20, 0x70, // 1
+            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+        };
+
+        // 8x10 digits for FX30, SUPER-CHIP only had 0-9, XO-CHIP added A-F
+        static constexpr uint8_t bigFontset[160] = {
+            0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+            0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+            0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+            0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+            0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+            0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+            0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+            0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+            0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+            0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+            0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+            0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+            0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+            0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+            0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+            0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+        };
+
+        // Load font set into memory (at location 0x000 to 0x050), plus the big font after it on SUPER-CHIP and XO-CHIP
+        void loadFontset() {
+            std::copy_n(fontset, 80, memory);
+            if constexpr (Model::SUPER_CHIP) {
+                std::copy_n(bigFontset, 160, memory + BIG_FONT_ADDRESS);
+            }
+            invalidateDecodeCache();
+        }
 
-        std::mutex mux;
+        // Load a ROM file into memory at 0x200, returns false if it can't be read or doesn't fit
+        bool loadROM(const std::string& romPath) {
+            std::fstream inputStream(romPath, std::ios::in | std::ios::binary | std::ios::ate);
 
+            if (!inputStream.is_open()) {
+                std::cerr << "Problem reading file " << romPath << "\n";
+                return false;
+            }
 
+            romSize = inputStream.tellg();    
+            inputStream.seekg(0, std::ios::beg);
 
+            if (romSize > 0 && romSize <= MAX_ROM_SIZE) {
+                inputStream.read(reinterpret_cast<char*>(&memory[0x200]), romSize);
+                invalidateDecodeCache();
+            } else {
+                std::cerr << "ROM too big or empty " << romPath << "\n";
+                romSize = 0;
+                return false;
+            }
 
+            return true;
+        }
+
+        // Copy a ROM already in memory to 0x200, the caller has checked 0 < size <= MAX_ROM_SIZE.
+        // Only the ROM's instructions are re-decoded, call after loadFontset()
+        void loadROM(const uint8_t* rom, size_t size) {
+            std::copy_n(rom, size, memory + 0x200);
+            romSize = size;
+            invalidateDecodeCache(0x200, size);
+        }
+
+        // Re-decodes every instruction, call this after writing to memory behind the interpreter's back
+        void invalidateDecodeCache() {
+            invalidateDecodeCache(0, MEMORY_SIZE);
+        }
+
+        // Re-decodes every instruction overlapping memory[address] to memory[address + length - 1], wrapping
+        // past the end of memory the way I-relative writes do.
+        // Entries are refreshed eagerly rather than flagged, so the fetch path never has to check them
+        void invalidateDecodeCache(uint16_t address, uint32_t length) {
+            uint32_t first = address & ADDRESS_MASK;
+            uint32_t end = first + std::min(length, MEMORY_SIZE);
+            if (end > MEMORY_SIZE) {
+                redecode(0, end - MEMORY_SIZE);
+                end = MEMORY_SIZE;
+            }
+            redecode(first, end);
+        }
+
+        // Read next OpCode through the decode cache and increment program counter.
+        // Instructions at odd addresses are legal but rare, they are decoded every time
+        DecodedOp fetchDecodedOpCode() {
+            DecodedOp op;
+            if (!(pc & 1)) {
+                op = decodeCache[pc >> 1];
+            } else {
+                uint16_t opcode = (memory[pc] << 8) | memory[(pc + 1) & ADDRESS_MASK];
+                op = DecodedOp{opcode, opClassTable.entries[opcode]};
+            }
+            pc += 2;
+            return op;
+        }
 
-        
-        
         uint16_t readNextOpCode() {
             if (!hasMoreOpcodes()) {
                 // Could throw, return 0, or handle gracefully
@@ -55,8 +455,64 @@ class Chip8 {
             return opCode;
         }
 
-        // This method is huge, but I can't be bothered to do something more 'optimal' for a pet project
+        // Fetches and executes the next OpCode with a single indirect call through the handler table
         void decodeNextOpCode() {
+            if (!hasMoreOpcodes()) {
+                return;
+            }
+            DecodedOp op = fetchDecodedOpCode();
+            CHIP8_PROFILE_HOOK(instruction(pc - 2, op.opClass));
+            execute(op);
+        }
+
+        // Executes an already fetched OpCode, pc must already point past it
+        void execute(DecodedOp op) {
+            using OpHandler = void (*)(BasicChip8&, uint16_t);
+            static constexpr OpHandler handlers[OP_COUNT] = {
+#define CHIP8_OPCODE_HANDLER(name, body) [](BasicChip8& self, [[maybe_unused]] uint16_t opcode) { body; },
+                CHIP8_OPCODES(CHIP8_OPCODE_HANDLER)
+#undef CHIP8_OPCODE_HANDLER
+            };
+
+            handlers[op.opClass](*this, op.opcode);
+        }
+
+#if CHIP8_COMPUTED_GOTO
+        // Executes up to 'count' instructions with computed-goto threading: every handler ends by
+        // fetching the next opcode and jumping straight to its label, there is no central dispatch loop.
+        // Returns the number of instructions executed
+        int executeThreaded(int count) {
+            static void* const labels[OP_COUNT] = {
+#define CHIP8_OPCODE_LABEL(name, body) &&op_##name,
+                CHIP8_OPCODES(CHIP8_OPCODE_LABEL)
+#undef CHIP8_OPCODE_LABEL
+            };
+
+            BasicChip8& self = *this;
+            int executed = 0;
+            DecodedOp op;
+            uint16_t opcode;
+
+#define CHIP8_DISPATCH() \
+            if (executed == count || !hasMoreOpcodes()) return executed; \
+            op = fetchDecodedOpCode(); \
+            opcode = op.opcode; \
+            executed++; \
+            CHIP8_PROFILE_HOOK(instruction(pc - 2, op.opClass)); \
+            goto *labels[op.opClass]
+
+            CHIP8_DISPATCH();
+#define CHIP8_OPCODE_BODY(name, body) op_##name: body; CHIP8_DISPATCH();
+            CHIP8_OPCODES(CHIP8_OPCODE_BODY)
+#undef CHIP8_OPCODE_BODY
+#undef CHIP8_DISPATCH
+        }
+#endif
+
+        // Original decoder: re-extracts every nibble and walks a two-level switch on each instruction.
+        // Kept as the reference the handler table is checked and benchmarked against, CHIP-8 instructions only
+        // This method is huge, but I can't be bothered to do something more 'optimal' for a pet project
+        void decodeNextOpCodeSwitch() {
         uint16_t opcode = fetchNextOpCode();
 
         if (opcode == 0) {
@@ -211,18 +667,178 @@ class Chip8 {
 }
 
         bool hasMoreOpcodes() {
+            if (stackFault) return false;
+            if constexpr (Model::SUPER_CHIP) {
+                if (this->exited) return false;
+            }
             return pc < (0x200 + romSize);
         }
 
+        // Keypad state as a bit per key, bit n is key n
+        uint16_t keypadMask() const {
+            uint16_t mask = 0;
+            for (int key = 0; key < 16; key++) {
+                mask |= (keypad[key] ? 1 : 0) << key;
+            }
+            return mask;
+        }
+
+        // Applies a keypad change, the lowest key that went down becomes the one Fx0A picks up.
+        // Frontends should only call this when the mask actually changed, so a movie replay sees the same edges
+        void setKeypadMask(uint16_t mask) {
+            uint16_t pressed = mask & ~keypadMask();
+            pressedKey = pressed ? __builtin_ctz(pressed) : 0xFF;
+            for (int key = 0; key < 16; key++) {
+                keypad[key] = (mask >> key) & 1;
+            }
+        }
+
+        // Seeds the CXNN random generator, the same seed always produces the same run
+        void seedRandom(uint32_t seed) {
+            randomState = seed ? seed : 0x2545F491;  // xorshift never leaves 0
+        }
+
+        // FNV-1a hash of the display, cheap enough to compare whole runs by their final frame
+        uint64_t framebufferHash() const {
+            uint64_t hash = 0xCBF29CE484222325;
+            for (uint64_t row : gfx) {
+                for (int byte = 0; byte < 8; byte++) {
+                    hash ^= (row >> (56 - 8 * byte)) & 0xFF;
+                    hash *= 0x100000001B3;
+                }
+            }
+            return hash;
+        }
+
+        // True when the program is spinning on a jump to itself with both timers stopped,
+        // without input nothing can change anymore (most test ROMs end like this)
+        bool isHalted() const {
+            uint16_t opcode = (memory[pc] << 8) | memory[(pc + 1) & ADDRESS_MASK];
+            return (opcode & 0xF000) == 0x1000 && (opcode & 0x0FFF) == pc && delay_timer == 0 && sound_timer == 0;
+        }
+
+        // Whether one sprite pixel is one display pixel, false in SUPER-CHIP low resolution where they are 2x2
+        bool highResolution() const {
+            if constexpr (Model::SUPER_CHIP) {
+                return this->hires;
+            }
+            return true;
+        }
+
+        // Returns whether the pixel at column x (0-63), row y (0-31) is on, on the extended models in
+        // display coordinates (0-127, 0-63) and in the first plane
+        bool pixel(int x, int y) const {
+            return (gfx[y * Display::ROW_WORDS + x / 64] >> (63 - x % 64)) & 1;
+        }
+
+        // Returns how many of the next 'budget' instructions are an idle spin that can be skipped without
+        // executing them, fast-forwarding the machine past them (0 if pc isn't in an idle loop).
+        // Recognized are a jump to itself, Fx0A while no key is pending, DXYN waiting for the display, and the delay timer poll
+        // 'Fx07; 3x00; 1NNN' (NNN pointing back at the Fx07) while the timer is still running.
+        // Skipping only whole iterations leaves the machine exactly where executing them would
+        int skipIdle(int budget) {
+            uint16_t opcode = (memory[pc] << 8) | memory[(pc + 1) & ADDRESS_MASK];
+            int skipped = 0;
+            uint16_t loopStart = 0;     // where a delay timer poll would begin, from whichever of its instructions pc is on
+
+            switch (opcode >> 12) {
+                case 0x1:
+                    if (opNNN(opcode) == pc) {
+                        skipped = budget;
+                    } else {
+                        loopStart = pc - 4;
+                    }
+                    break;
+                case 0x3:
+                    loopStart = pc - 2;
+                    break;
+                case 0xD:
+                    if (Quirks::DISPLAY_WAIT && drewThisFrame) {
+                        skipped = budget;
+                    }
+                    break;
+                case 0xF:
+                    if (opNN(opcode) == 0x0A && pressedKey == 0xFF) {
+                        skipped = budget;
+                        CHIP8_PROFILE_HOOK(keyWaitSpin(budget));
+                    } else {
+                        loopStart = pc;
+                    }
+                    break;
+                default:
+                    return 0;
+            }
+
+            if (loopStart >= 0x200 && size_t(loopStart) + 6 <= 0x200 + romSize && delay_timer > 0) {
+                uint16_t poll = (memory[loopStart] << 8) | memory[loopStart + 1];
+                uint16_t test = (memory[loopStart + 2] << 8) | memory[loopStart + 3];
+                uint16_t jump = (memory[loopStart + 4] << 8) | memory[loopStart + 5];
+                uint8_t x = opX(poll);
+                if ((poll & 0xF0FF) == 0xF007 && test == (0x3000 | x << 8) && jump == (0x1000 | loopStart)
+                    && (pc != loopStart + 2 || registers[x] != 0)) {
+                    skipped = budget / 3 * 3;
+                    if (skipped > 0) registers[x] = delay_timer;
+                }
+            }
+
+            CHIP8_PROFILE_HOOK(idle(skipped));
+            return skipped;
+        }
+
+        // Ticks the 60Hz delay and sound timers once, returns true when the sound timer just ran out.
+        // This is also the vblank a DISPLAY_WAIT draw waits for
+        bool tickTimers() {
+            drewThisFrame = false;
+            if (delay_timer > 0) delay_timer--;
+            if (sound_timer > 0) {
+                sound_timer--;
+                if (sound_timer == 0) {
+                    beepFlag = true;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Runs one 60Hz frame: up to 'cyclesPerFrame' instructions followed by a single timer tick,
+        // the host is expected to poll input and present video only between calls.
+        // Returns the number of instructions executed, which is less than requested once the ROM runs out
+        // Idle loops are looked for every IDLE_CHECK_INTERVAL instructions and skipped up to the end of the frame
+        int runFrame(int cyclesPerFrame) {
+            int executed = 0;
+            while (executed < cyclesPerFrame && hasMoreOpcodes()) {
+                executed += skipIdle(cyclesPerFrame - executed);
+                int batch = std::min(cyclesPerFrame - executed, IDLE_CHECK_INTERVAL);
+                if (batch == 0) break;
+#if CHIP8_COMPUTED_GOTO
+                executed += executeThreaded(batch);
+#else
+                for (int i = 0; i < batch && hasMoreOpcodes(); i++, executed++) {
+                    decodeNextOpCode();
+                }
+#endif
+            }
+            cycleCount += executed;
+            frameCount++;
+            tickTimers();
+            return executed;
+        }
+
         // Processes OpCode '00E0', which clears the screen or display buffer
         void clearScreen() {
-            std::fill_n(gfx, 64*32, 0);
-            // Update the display after clearing
-            displayScreen();
+            forEachPlane([](uint64_t* plane) { Display::clear(plane); });
+            // Let the frontend know the display changed
+            dirtyRows = Display::ALL_ROWS;
         }
 
-        // Processes OpCode '00EE', which returns from a subroutine by decrementing the stack once
+        // Processes OpCode '00EE', which returns from a subroutine by decrementing the stack once.
+        // With an empty stack it raises stackFault instead of reading below the stack
         void returnFromSubroutine(){
+            if (sp == 0) {
+                stackFault = true;
+                return;
+            }
+            CHIP8_PROFILE_HOOK(ret());
             pc = stack[sp];
             sp--;
         }
@@ -232,8 +848,14 @@ class Chip8 {
             pc = newPC;
         }
 
-        // Processes OpCode '2NNN', which calls a new subroutine and sets the top of the stack to the current program counter
+        // Processes OpCode '2NNN', which calls a new subroutine and sets the top of the stack to the current program counter.
+        // stack[0] is never used, so 15 calls fill it and the 16th raises stackFault instead of writing past it
         void callSubroutine(uint16_t newSubroutine){
+            if (sp >= 15) {
+                stackFault = true;
+                return;
+            }
+            CHIP8_PROFILE_HOOK(call(newSubroutine));
             sp++;
             stack[sp] = pc;
 
@@ -243,21 +865,21 @@ class Chip8 {
         // Processes OpCode '3XNN', which skips the next OpCode if register X holds value equal to NN
         void skipNextInstructionValueEq(uint8_t x, uint8_t value){
             if(registers[x] == value){
-                pc +=2;
+                skip();
             }
         }
 
         // Processes OpCode '4XNN', which skips the next OpCode if register X holds value different to NN
         void skipNextInstructionValueDiff(uint8_t x, uint8_t value){
             if(registers[x] != value){
-                pc +=2;
+                skip();
             }
         }
 
         // Processes OpCode '5XY0', which skips the next OpCode if register X holds value is equal to register Y
         void skipNextInstructionRgister(uint8_t x, uint8_t y){
             if(registers[x] == registers[y]){
-                pc +=2;
+                skip();
             }
         }
 
@@ -279,22 +901,25 @@ class Chip8 {
         // Processes OpCode '8XY1', performs an OR operation on the values of Vx and Vy and stores the value on Vx
         void bitwiseOR(uint8_t x, uint8_t y){
             registers[x] = registers[x] | registers[y];
+            if constexpr (Quirks::VF_RESET) registers[0xF] = 0;
         }
 
         // Processes OpCode '8XY2', performs an AND operation on the values of Vx and Vy and stores the value on Vx
         void bitwiseAND(uint8_t x, uint8_t y){
             registers[x] = registers[x] & registers[y];
+            if constexpr (Quirks::VF_RESET) registers[0xF] = 0;
         }
 
         // Processes OpCode '8XY3', performs an AND operation on the values of Vx and Vy and stores the value on Vx
         void bitwiseXOR(uint8_t x, uint8_t y){
             registers[x] = registers[x] ^ registers[y];
+            if constexpr (Quirks::VF_RESET) registers[0xF] = 0;
         }
 
         // Processes OpCode '8XY4', Vx = Vx + Vy, if Vx > 255 then VF is set to 1 and the lowest 8 bits of the result are stored in Vx
         void registersADD(uint8_t x, uint8_t y){
             if(255 < (registers[x] + registers[y])){
-                registers[x] = (registers[x] + registers[y]) - 255;
+                registers[x] = (registers[x] + registers[y]) - 256;
                 registers[0xF] = 1;
             }else{
                 registers[x] = (registers[x] + registers[y]);
@@ -302,9 +927,9 @@ class Chip8 {
             }
         }
 
-        // Processes OpCode '8XY5', Vx = Vx - Vy, if Vx > Vy then VF is set to 1 otherwise 0
+        // Processes OpCode '8XY5', Vx = Vx - Vy, if Vx >= Vy (no borrow) then VF is set to 1 otherwise 0
         void registersSUB(uint8_t x, uint8_t y){
-            if(registers[x] > registers[y]){
+            if(registers[x] >= registers[y]){
                 registers[x] = (registers[x] - registers[y]) ;
                 registers[0xF] = 1;
             }else{
@@ -316,15 +941,17 @@ class Chip8 {
         // Processes OpCode '8XY6', which divides Vx by 2 (right bitshift of 1), if Vx is odd it sets VF to 1
         // Note: this instruction includes register Vy as it is believed that originally this instruction meant to store in Vx the value of Vy bitshifted
         // but since it was undocumented in the originaly system specifications it was mostly reverse engineered and Vy seems to be not be used.
+        // Which of the two depends on the SHIFT_VX quirk
         void registersSHR(uint8_t x, uint8_t y){
-            registers[0xF] = (registers[x] << 7);
-            registers[0xF] = registers[0xF] >> 7;
+            if constexpr (!Quirks::SHIFT_VX) registers[x] = registers[y];
+            uint8_t flag = registers[x] & 1;
             registers[x] = registers[x] >> 1;
+            registers[0xF] = flag;      // written last, so it wins when x is F
         }
 
-        // Processes OpCode '8XY7', Vx = Vy - Vx, if Vy > Vx then VF is set to 1 otherwise 0
+        // Processes OpCode '8XY7', Vx = Vy - Vx, if Vy >= Vx (no borrow) then VF is set to 1 otherwise 0
         void registersSUBN(uint8_t x, uint8_t y){
-            if(registers[y] > registers[x]){
+            if(registers[y] >= registers[x]){
                 registers[x] = (registers[y] - registers[x]) ;
                 registers[0xF] = 1;
             }else{
@@ -336,15 +963,18 @@ class Chip8 {
         // Processes OpCode '8XYE', which multiplies Vx by 2 (left bitshift of 1), if Vx >= 128 (10000000) it sets VF to 1
         // Note: this instruction includes register Vy as it is believed that originally this instruction meant to store in Vx the value of Vy bitshifted
         // but since it was undocumented in the originaly system specifications it was mostly reverse engineered and Vy seems to be not be used.
+        // Which of the two depends on the SHIFT_VX quirk
         void registersSHL(uint8_t x, uint8_t y){
-            registers[0xF] = registers[x] >> 7;
+            if constexpr (!Quirks::SHIFT_VX) registers[x] = registers[y];
+            uint8_t flag = registers[x] >> 7;
             registers[x] = registers[x] << 1;
+            registers[0xF] = flag;      // written last, so it wins when x is F
         }
 
         // Processes OpCode '9XY0', which skips the next instruction of the values of Vx and Vy differ.
         void skipNextInstruction(uint8_t x, uint8_t y){
             if(registers[x] != registers[y]){
-                pc +=2;
+                skip();
             }
         }
 
@@ -354,13 +984,22 @@ class Chip8 {
         }
 
         // Processes OpCode 'BNNN', which sets pc to NNN + V0, basically a more complex version of the jump command, I assume for bigger jumps
+        // With the JUMP_VX quirk (CHIP-48 and SUPER-CHIP) it is 'BXNN' and jumps to XNN + Vx
         void jumpWithV0(uint16_t value){
-            pc = registers[0] + value;
+            if constexpr (Quirks::JUMP_VX) {
+                pc = registers[value >> 8] + value;
+            } else {
+                pc = registers[0] + value;
+            }
         }
 
         // Processes OpCode 'CXNN', which sets Vx value to the result of the AND operation between a random byte and NN.
         void randomByteAnd(uint8_t x, uint8_t value){
-            uint8_t randomByte = rand();
+            // xorshift32, every instance has its own state so runs are reproducible and thread-safe
+            randomState ^= randomState << 13;
+            randomState ^= randomState >> 17;
+            randomState ^= randomState << 5;
+            uint8_t randomByte = randomState >> 24;
 
             registers[x] = randomByte & value;
             
@@ -373,60 +1012,97 @@ class Chip8 {
         // The operation will go to the memory location pointed to by the Index Register (I) and grab N bytes from it
         // after this it will draw N rows of 8 pixels (1-byte = 8-bits, 1-bit = pixel) by XOR'ing the bit's corresponding
         // to each pixel, if a bit is XOR'd to 0 (1XOR1) VF (V15 or register 15) will be set to 1, otherwise it is set to 0
+        // Since every display row is a single 64-bit word, each sprite row is one rotate, one AND and one XOR
+        // SUPER-CHIP and XO-CHIP draw through drawExtended()
         void drawOnScreen(uint8_t vx, uint8_t vy, uint8_t n){
-            registers[0xF] = 0;
-
-            // get coords from registers
-            uint8_t x = registers[vx];
-            uint8_t y = registers[vy];
-
-            // initiate spriteBuffer with rows of pixels for sprite
-            uint8_t spriteBuffer[n];
-            std::copy(&memory[I], &memory[I]+n, spriteBuffer);
-
-            for(int i=0; i<n; i++){
-                uint8_t xCoord = x;
-                uint8_t yCoord = y + i;
-                
-                // check if the sprite goes over vertical edge of the screen, if so it wraps around
-                if(yCoord >= 32) { yCoord = 0; }
-
-                std::bitset<8> bits(spriteBuffer[i]);   // sprite byte 'n' split into bits to XOR with screen bits
-
-                for(int j=0; j<8; j++){
-
-                    bool pixelWasOn = true;
-                    xCoord = x + j;
-                    
-                    // check if the sprite goes over horizontal edge of the screen, if so it wraps around
-                    if(xCoord >= 64) { xCoord = 0; }
+            if constexpr (Quirks::DISPLAY_WAIT) {
+                // the VIP only draws in vblank, try again once the frame is over
+                if (drewThisFrame) {
+                    pc -= 2;
+                    return;
+                }
+                drewThisFrame = true;
+            }
+            if constexpr (Model::SUPER_CHIP) {
+                drawExtended(vx, vy, n);
+            } else {
+                // get coords from registers, before VF is reset in case it is one of them
+                uint8_t x = registers[vx] % Display::WIDTH;
+                uint8_t y = registers[vy];
+
+                typename Display::Row collision = 0;
+
+                // sprites going over the vertical edge of the screen wrap around, or are cut off with CLIPPING
+                y %= Display::HEIGHT;
+                if constexpr (Quirks::CLIPPING) {
+                    n = std::min<int>(n, Display::HEIGHT - y);
+                }
 
-                    int index = yCoord * 64 + xCoord;
-                    
-                    if (gfx[index] == 0) {pixelWasOn = false;}
+                for(int i=0; i<n; i++){
+                    uint8_t yCoord = (y + i) % Display::HEIGHT;
 
-                    gfx[index] = ((uint8_t)bits[7 - j] ^ gfx[index]);
+                    // sprite byte at the left edge, rotated right so anything past the horizontal edge wraps around to column 0
+                    typename Display::Row spriteRow = Display::spriteRow(memory[(I + i) & ADDRESS_MASK], 8);
+                    if constexpr (Quirks::CLIPPING) {
+                        collision |= Display::xorRowClipped(gfx, x, yCoord, spriteRow);
+                    } else {
+                        collision |= Display::xorRow(gfx, x, yCoord, spriteRow);
+                    }
+                    dirtyRows |= RowMask(1) << yCoord;
+                }
 
-                    if (gfx[index] == 0 && pixelWasOn == true){ registers[0xF] = 1;}
+                registers[0xF] = collision != 0;
+            }
+        }
 
+        // 'DXYN' on SUPER-CHIP and XO-CHIP: N = 0 draws a 16x16 sprite (two bytes per row), in low resolution
+        // every sprite pixel covers 2x2 display pixels. With several planes selected the sprite data for each
+        // plane follows the previous plane's. VF is set if any plane had a collision
+        void drawExtended(uint8_t vx, uint8_t vy, uint8_t n){
+            const int scale = highResolution() ? 1 : 2;
+            const int x = registers[vx] % (Display::WIDTH / scale) * scale;
+            const int y = registers[vy] % (Display::HEIGHT / scale) * scale;
+            const bool wide = n == 0;
+            const int rows = wide ? 16 : n;
+            const int width = (wide ? 16 : 8) * scale;
+
+            uint16_t address = I;
+            typename Display::Row collision = 0;
+            forEachPlane([&](uint64_t* plane) {
+                for (int i = 0; i < rows; i++) {
+                    uint32_t bits = memory[address & ADDRESS_MASK];
+                    if (wide) bits = (bits << 8) | memory[(address + 1) & ADDRESS_MASK];
+                    address += wide ? 2 : 1;
+                    if (scale == 2) bits = doubleBits(bits);
+
+                    typename Display::Row spriteRow = Display::spriteRow(bits, width);
+                    for (int copy = 0; copy < scale; copy++) {
+                        int row = (y + i * scale + copy) % Display::HEIGHT;
+                        if constexpr (Quirks::CLIPPING) {
+                            if (y + i * scale + copy >= Display::HEIGHT) break;
+                            collision |= Display::xorRowClipped(plane, x, row, spriteRow);
+                        } else {
+                            collision |= Display::xorRow(plane, x, row, spriteRow);
+                        }
+                        dirtyRows |= RowMask(1) << row;
+                    }
                 }
-                
-            }
-            displayScreen();
-            
+            });
+
+            registers[0xF] = collision != 0;
         }
 
         // Processed OpCode 'Ex9E', which skips the next OpCode if key in Vx is pressed
         void skipNextInstructionIfKeyPressed(uint8_t x){
-            if(keypad[registers[x]] == 1){
-                pc +=2;
+            if(keypad[registers[x] & 0xF] == 1){
+                skip();
             }
         }
 
         // Processed OpCode 'ExA1', which skips the next OpCode if key in Vx is NOT pressed
         void skipNextInstructionIfKeyNotPressed(uint8_t x){
-            if(keypad[registers[x]] == 0){
-                pc +=2;
+            if(keypad[registers[x] & 0xF] == 0){
+                skip();
             }
         }
 
@@ -437,11 +1113,12 @@ class Chip8 {
 
         // Processes OpCode 'Fx0A', which wait for a key press, store the value of the key in Vx
         void waitForKeyPress(uint8_t x){
-            if(pressedKey == -1){
+            if(pressedKey == 0xFF){
+                CHIP8_PROFILE_HOOK(keyWaitSpin(1));
                 pc -=2;
             }else{
                 registers[x] = pressedKey;
-                pressedKey = -1;
+                pressedKey = 0xFF;
             }
         }
 
@@ -476,164 +1153,211 @@ class Chip8 {
         // - memory[I+2] = 6 (ones digit)
         void storeBCDRepresentation(uint8_t x){
             uint8_t value = registers[x];
-            memory[I] = value / 100;                // Hundreds digit
-            memory[I + 1] = (value / 10) % 10;      // Tens digit
-            memory[I + 2] = value % 10;             // Ones digit
+            memory[I & ADDRESS_MASK] = value / 100;                // Hundreds digit
+            memory[(I + 1) & ADDRESS_MASK] = (value / 10) % 10;    // Tens digit
+            memory[(I + 2) & ADDRESS_MASK] = value % 10;           // Ones digit
+            invalidateDecodeCache(I, 3);
         }
 
         // Processes OpCode 'Fx55', which stores the values of registers V0->Vx into memory starting from I
         void assignToMemory(uint8_t x){
             for(int j = 0; j<=x; j++){
-                memory[I+j] = registers[j];
+                memory[(I + j) & ADDRESS_MASK] = registers[j];
             }
+            invalidateDecodeCache(I, x + 1);
+            advanceIndex(x);
         }
 
         // Processes OpCode 'Fx65', which stores the values of registers V0->Vx into memory starting from I
         void assignToRegisters(uint8_t x){
             for(int j = 0; j<=x; j++){
-                registers[j] = memory[I+j];
+                registers[j] = memory[(I + j) & ADDRESS_MASK];
             }
+            advanceIndex(x);
         }
 
-        // Initialize SDL systems
-        bool initializeSDL() {
-            if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
-                std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
-                return false;
+        // Processes OpCode '00CN' (SUPER-CHIP), which scrolls the display down N pixels
+        void scrollDown([[maybe_unused]] uint8_t n){
+            if constexpr (Model::SUPER_CHIP) {
+                const int rows = n * (highResolution() ? 1 : 2);
+                forEachPlane([rows](uint64_t* plane) { Display::scrollDown(plane, rows); });
+                dirtyRows = Display::ALL_ROWS;
             }
-            
-            window = SDL_CreateWindow("CHIP-8 Emulator", 
-                                      SDL_WINDOWPOS_CENTERED, 
-                                      SDL_WINDOWPOS_CENTERED,
-                                      64 * PIXEL_SIZE, 
-                                      32 * PIXEL_SIZE, 
-                                      SDL_WINDOW_SHOWN);
-            if (!window) {
-                std::cerr << "Window creation failed: " << SDL_GetError() << std::endl;
-                return false;
+        }
+
+        // Processes OpCode '00DN' (XO-CHIP), which scrolls the display up N pixels
+        void scrollUp([[maybe_unused]] uint8_t n){
+            if constexpr (Model::XO_CHIP) {
+                const int rows = n * (highResolution() ? 1 : 2);
+                forEachPlane([rows](uint64_t* plane) { Display::scrollUp(plane, rows); });
+                dirtyRows = Display::ALL_ROWS;
             }
-            
-            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-            if (!renderer) {
-                std::cerr << "Renderer creation failed: " << SDL_GetError() << std::endl;
-                return false;
+        }
+
+        // Processes OpCode '00FB' (SUPER-CHIP), which scrolls the display right 4 pixels
+        void scrollRight(){
+            if constexpr (Model::SUPER_CHIP) {
+                const int pixels = highResolution() ? 4 : 8;
+                forEachPlane([pixels](uint64_t* plane) { Display::scrollRight(plane, pixels); });
+                dirtyRows = Display::ALL_ROWS;
             }
-            
-            texture = SDL_CreateTexture(renderer, 
-                                        SDL_PIXELFORMAT_RGBA8888, 
-                                        SDL_TEXTUREACCESS_STREAMING, 
-                                        64, 32);
-            if (!texture) {
-                std::cerr << "Texture creation failed: " << SDL_GetError() << std::endl;
-                return false;
+        }
+
+        // Processes OpCode '00FC' (SUPER-CHIP), which scrolls the display left 4 pixels
+        void scrollLeft(){
+            if constexpr (Model::SUPER_CHIP) {
+                const int pixels = highResolution() ? 4 : 8;
+                forEachPlane([pixels](uint64_t* plane) { Display::scrollLeft(plane, pixels); });
+                dirtyRows = Display::ALL_ROWS;
             }
-            
-            // Initialize pixels to OFF_COLOR
-            for (int i = 0; i < 64 * 32; i++) {
-                pixels[i] = OFF_COLOR;
+        }
+
+        // Processes OpCode '00FD' (SUPER-CHIP), which stops the interpreter
+        void exitInterpreter(){
+            if constexpr (Model::SUPER_CHIP) {
+                this->exited = true;
             }
-            
-            return true;
         }
-        
-        // Cleanup SDL resources
-        void cleanupSDL() {
-            if (texture) {
-                SDL_DestroyTexture(texture);
-                texture = nullptr;
+
+        // Processes OpCodes '00FE' and '00FF' (SUPER-CHIP), which switch to 64x32 or 128x64 and clear every plane
+        void setHighResolution([[maybe_unused]] bool on){
+            if constexpr (Model::SUPER_CHIP) {
+                this->hires = on;
+                std::fill_n(gfx, Display::WORDS, 0);
+                dirtyRows = Display::ALL_ROWS;
             }
-            if (renderer) {
-                SDL_DestroyRenderer(renderer);
-                renderer = nullptr;
+        }
+
+        // Processes OpCode '5XY2' (XO-CHIP), which stores Vx to Vy (in either order) at I, I is left unchanged
+        void storeRegisterRange([[maybe_unused]] uint8_t x, [[maybe_unused]] uint8_t y){
+            if constexpr (Model::XO_CHIP) {
+                const int step = x <= y ? 1 : -1;
+                const int count = std::abs(x - y) + 1;
+                for (int i = 0; i < count; i++) {
+                    memory[(I + i) & ADDRESS_MASK] = registers[x + i * step];
+                }
+                invalidateDecodeCache(I, count);
             }
-            if (window) {
-                SDL_DestroyWindow(window);
-                window = nullptr;
+        }
+
+        // Processes OpCode '5XY3' (XO-CHIP), which loads Vx to Vy (in either order) from I, I is left unchanged
+        void loadRegisterRange([[maybe_unused]] uint8_t x, [[maybe_unused]] uint8_t y){
+            if constexpr (Model::XO_CHIP) {
+                const int step = x <= y ? 1 : -1;
+                const int count = std::abs(x - y) + 1;
+                for (int i = 0; i < count; i++) {
+                    registers[x + i * step] = memory[(I + i) & ADDRESS_MASK];
+                }
             }
-            SDL_Quit();
         }
-        
-        // Handle SDL events and input
-        void handleInput() {
-            SDL_Event event;
-            while (SDL_PollEvent(&event)) {
-                if (event.type == SDL_QUIT) {
-                    exit(0); 
-                } else if (event.type == SDL_KEYDOWN) {
-
-                    // Map keyboard keys to CHIP-8 keypad according to requested layout:
-                    // Keyboard:   CHIP-8 hex value mapping:
-                    // 1 2 3 4     1 2 3 C
-                    // q w e r     4 5 6 D
-                    // a s d f     7 8 9 E
-                    // z x c v     A 0 B F
-                    switch (event.key.keysym.sym) {
-                        case SDLK_1: keypad[0x1] = 1; break; // 1
-                        case SDLK_2: keypad[0x2] = 1; break; // 2
-                        case SDLK_3: keypad[0x3] = 1; break; // 3
-                        case SDLK_4: keypad[0xC] = 1; break; // C
-                        
-                        case SDLK_q: keypad[0x4] = 1; break; // 4
-                        case SDLK_w: keypad[0x5] = 1; break; // 5
-                        case SDLK_e: keypad[0x6] = 1; break; // 6
-                        case SDLK_r: keypad[0xD] = 1; break; // D
-                        
-                        case SDLK_a: keypad[0x7] = 1; break; // 7
-                        case SDLK_s: keypad[0x8] = 1; break; // 8
-                        case SDLK_d: keypad[0x9] = 1; break; // 9
-                        case SDLK_f: keypad[0xE] = 1; break; // E
-                        
-                        case SDLK_z: keypad[0xA] = 1; break; // A
-                        case SDLK_x: keypad[0x0] = 1; break; // 0
-                        case SDLK_c: keypad[0xB] = 1; break; // B
-                        case SDLK_v: keypad[0xF] = 1; break; // F
-                        
-                        case SDLK_ESCAPE: exit(0); break;    // ESC to quit
-                    }
-                } else if (event.type == SDL_KEYUP) {
-                    switch (event.key.keysym.sym) {
-                        case SDLK_1: keypad[0x1] = 0; break;
-                        case SDLK_2: keypad[0x2] = 0; break;
-                        case SDLK_3: keypad[0x3] = 0; break;
-                        case SDLK_4: keypad[0xC] = 0; break;
-                        
-                        case SDLK_q: keypad[0x4] = 0; break;
-                        case SDLK_w: keypad[0x5] = 0; break;
-                        case SDLK_e: keypad[0x6] = 0; break;
-                        case SDLK_r: keypad[0xD] = 0; break;
-                        
-                        case SDLK_a: keypad[0x7] = 0; break;
-                        case SDLK_s: keypad[0x8] = 0; break;
-                        case SDLK_d: keypad[0x9] = 0; break;
-                        case SDLK_f: keypad[0xE] = 0; break;
-                        
-                        case SDLK_z: keypad[0xA] = 0; break;
-                        case SDLK_x: keypad[0x0] = 0; break;
-                        case SDLK_c: keypad[0xB] = 0; break;
-                        case SDLK_v: keypad[0xF] = 0; break;
-                    }
+
+        // Processes OpCode 'F000 NNNN' (XO-CHIP), which loads I with the 16-bit word following the instruction
+        void setIndexLong(){
+            if constexpr (Model::XO_CHIP) {
+                I = (memory[pc & ADDRESS_MASK] << 8) | memory[(pc + 1) & ADDRESS_MASK];
+                pc += 2;
+            }
+        }
+
+        // Processes OpCode 'FN01' (XO-CHIP), which selects the planes drawing, clearing and scrolling act on
+        void selectPlanes([[maybe_unused]] uint8_t n){
+            if constexpr (Model::XO_CHIP) {
+                this->planeMask = n & ((1 << Model::PLANES) - 1);
+            }
+        }
+
+        // Processes OpCode 'F002' (XO-CHIP), which loads the 16-byte audio pattern from I
+        void loadAudioPattern(){
+            if constexpr (Model::XO_CHIP) {
+                for (int i = 0; i < 16; i++) {
+                    this->audioPattern[i] = memory[(I + i) & ADDRESS_MASK];
                 }
             }
         }
 
-        // Update the screen with SDL
-        void displayScreen() {
-            // Update pixel buffer from gfx array
-            for (int i = 0; i < 64 * 32; i++) {
-                pixels[i] = gfx[i] ? ON_COLOR : OFF_COLOR;
+        // Processes OpCode 'Fx30' (SUPER-CHIP), which sets I to the 8x10 sprite for digit Vx
+        void setIToBigDigitSprite([[maybe_unused]] uint8_t x){
+            if constexpr (Model::SUPER_CHIP) {
+                I = BIG_FONT_ADDRESS + (registers[x] & 0x0F) * 10;
             }
-            
-            // Update texture with new pixel data
-            SDL_UpdateTexture(texture, NULL, pixels, 64 * sizeof(uint32_t));
-            
-            // Clear renderer and render the texture
-            SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, texture, NULL, NULL);
-            SDL_RenderPresent(renderer);
-            
-            // Handle events
-            handleInput();
         }
 
-        
-};
\ No newline at end of file
+        // Processes OpCode 'Fx3A' (XO-CHIP), which sets the audio pattern pitch to Vx
+        void setPitch([[maybe_unused]] uint8_t x){
+            if constexpr (Model::XO_CHIP) {
+                this->pitch = registers[x];
+            }
+        }
+
+        // Processes OpCode 'Fx75' (SUPER-CHIP), which saves V0->Vx to the RPL flags (at most V0-V7 on SUPER-CHIP, all 16 on XO-CHIP)
+        void saveFlags([[maybe_unused]] uint8_t x){
+            if constexpr (Model::SUPER_CHIP) {
+                for (int j = 0; j <= std::min<int>(x, Model::XO_CHIP ? 15 : 7); j++) {
+                    this->rplFlags[j] = registers[j];
+                }
+            }
+        }
+
+        // Processes OpCode 'Fx85' (SUPER-CHIP), which loads V0->Vx from the RPL flags
+        void loadFlags([[maybe_unused]] uint8_t x){
+            if constexpr (Model::SUPER_CHIP) {
+                for (int j = 0; j <= std::min<int>(x, Model::XO_CHIP ? 15 : 7); j++) {
+                    registers[j] = this->rplFlags[j];
+                }
+            }
+        }
+
+    private:
+        // Refreshes the decode cache entries holding memory[first] to memory[end - 1]
+        void redecode(uint32_t first, uint32_t end) {
+            for (uint32_t entry = first >> 1; entry * 2 < end; entry++) {
+                uint16_t opcode = (memory[entry * 2] << 8) | memory[entry * 2 + 1];
+                decodeCache[entry] = DecodedOp{opcode, opClassTable.entries[opcode]};
+            }
+        }
+
+        // Where FX55/FX65 leave I, the MEMORY quirk
+        void advanceIndex(uint8_t x) {
+            if constexpr (Quirks::MEMORY == IndexIncrement::X) {
+                I += x;
+            } else if constexpr (Quirks::MEMORY == IndexIncrement::XPlusOne) {
+                I += x + 1;
+            }
+        }
+
+        // Skips the next instruction, on XO-CHIP that is the whole 4-byte 'F000 NNNN' if it is one
+        void skip() {
+            if constexpr (Model::XO_CHIP) {
+                if (memory[pc & ADDRESS_MASK] == 0xF0 && memory[(pc + 1) & ADDRESS_MASK] == 0x00) {
+                    pc += 2;
+                }
+            }
+            pc += 2;
+        }
+
+        // Calls 'f' with every plane selected by FN01, the only plane on single plane models
+        template <typename F>
+        void forEachPlane(F f) {
+            if constexpr (Model::PLANES == 1) {
+                f(gfx);
+            } else {
+                for (int p = 0; p < Model::PLANES; p++) {
+                    if (this->planeMask >> p & 1) f(Display::plane(gfx, p));
+                }
+            }
+        }
+};
+
+using Chip8 = BasicChip8<ClassicModel>;
+using Chip48 = BasicChip8<ClassicModel, Chip48Quirks>;
+using SuperChip8 = BasicChip8<SuperChipModel>;
+using XOChip8 = BasicChip8<XOChipModel>;
+
+// The core holds no pointers or handles, so instances can be copied, memcpy'd and packed in bulk
+static_assert(std::is_trivially_copyable<Chip8>::value, "Chip8 must stay trivially copyable");
+static_assert(std::is_trivially_copyable<SuperChip8>::value && std::is_trivially_copyable<XOChip8>::value,
+              "every model must stay trivially copyable");
+// The JIT and snapshots address Chip8 fields with offsetof, and the empty base must not move them
+static_assert(std::is_standard_layout<Chip8>::value, "Chip8 must stay standard layout");
+
+#endif
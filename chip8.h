@@ -4,6 +4,8 @@
 #include <iostream>
 #include <iomanip>  // for std::hex and std::setw
 #include <chrono>
-#include <SDL2/SDL.h>
+#include <thread>
 #include <bitset>    // for easier to read bitwise operations :)
-#include <mutex>
\ No newline at end of file
+#include <algorithm>
+#include <cstdlib>   // std::abs
+#include <type_traits>
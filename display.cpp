@@ -0,0 +1,120 @@
+#ifndef DISPLAY_CPP
+#define DISPLAY_CPP
+
+#include "display.h"
+
+// Bit-packed display of Width x Height pixels in Planes bitplanes, operating on storage owned by the
+// machine (so it stays part of the trivially copyable state). A row is Width / 64 consecutive 64-bit
+// words with bit 63 of the first word the leftmost pixel, planes follow each other. Rows are handled
+// as one integer (64 or 128 bits wide), so drawing a sprite row is a rotate, an AND and an XOR and
+// scrolling is a word-wide shift, whatever the resolution. Everything is resolved at compile time,
+// the 64x32 single plane engine compiles down to the same code as a plain uint64_t row array
+template <int Width, int Height, int Planes>
+struct DisplayEngine {
+    static_assert(Width == 64 || Width == 128, "rows are one or two 64-bit words");
+    static_assert(Height <= 64, "dirty rows are tracked in a 64-bit mask");
+
+    static constexpr int WIDTH = Width;
+    static constexpr int HEIGHT = Height;
+    static constexpr int PLANES = Planes;
+    static constexpr int ROW_WORDS = Width / 64;
+    static constexpr int PLANE_WORDS = ROW_WORDS * Height;
+    static constexpr int WORDS = PLANE_WORDS * Planes;
+
+    using Row = std::conditional_t<Width == 64, uint64_t, unsigned __int128>;
+    using RowMask = std::conditional_t<(Height <= 32), uint32_t, uint64_t>;
+    static constexpr RowMask ALL_ROWS = Height == 32 || Height == 64 ? ~RowMask(0) : (RowMask(1) << Height) - 1;
+
+    static uint64_t* plane(uint64_t* words, int index) {
+        return words + index * PLANE_WORDS;
+    }
+
+    static Row loadRow(const uint64_t* plane, int y) {
+        if constexpr (ROW_WORDS == 1) {
+            return plane[y];
+        } else {
+            return (Row(plane[y * 2]) << 64) | plane[y * 2 + 1];
+        }
+    }
+
+    static void storeRow(uint64_t* plane, int y, Row row) {
+        if constexpr (ROW_WORDS == 1) {
+            plane[y] = row;
+        } else {
+            plane[y * 2] = uint64_t(row >> 64);
+            plane[y * 2 + 1] = uint64_t(row);
+        }
+    }
+
+    // 'width' sprite bits (most significant first) moved to the left edge of a row
+    static Row spriteRow(uint32_t bits, int width) {
+        return Row(bits) << (Width - width);
+    }
+
+    // XORs a left-aligned sprite row in at column x (0 to Width - 1), wrapping past the right edge.
+    // Returns the pixels that were turned off, non-zero means a collision
+    static Row xorRow(uint64_t* plane, int x, int y, Row sprite) {
+        Row shifted = (sprite >> x) | (sprite << ((Width - x) % Width));
+        Row row = loadRow(plane, y);
+        storeRow(plane, y, row ^ shifted);
+        return row & shifted;
+    }
+
+    // Same as xorRow() but the part of the sprite past the right edge is dropped instead of wrapping
+    static Row xorRowClipped(uint64_t* plane, int x, int y, Row sprite) {
+        Row shifted = sprite >> x;
+        Row row = loadRow(plane, y);
+        storeRow(plane, y, row ^ shifted);
+        return row & shifted;
+    }
+
+    static void clear(uint64_t* plane) {
+        std::fill_n(plane, PLANE_WORDS, 0);
+    }
+
+    // Rows move by whole words, the rows scrolled in are blank
+    static void scrollDown(uint64_t* plane, int rows) {
+        rows = std::min(rows, Height);
+        std::memmove(plane + rows * ROW_WORDS, plane, (Height - rows) * ROW_WORDS * sizeof(uint64_t));
+        std::fill_n(plane, rows * ROW_WORDS, 0);
+    }
+
+    static void scrollUp(uint64_t* plane, int rows) {
+        rows = std::min(rows, Height);
+        std::memmove(plane, plane + rows * ROW_WORDS, (Height - rows) * ROW_WORDS * sizeof(uint64_t));
+        std::fill_n(plane + (Height - rows) * ROW_WORDS, rows * ROW_WORDS, 0);
+    }
+
+    static void scrollRight(uint64_t* plane, int pixels) {
+        for (int y = 0; y < Height; y++) {
+            storeRow(plane, y, loadRow(plane, y) >> pixels);
+        }
+    }
+
+    static void scrollLeft(uint64_t* plane, int pixels) {
+        for (int y = 0; y < Height; y++) {
+            storeRow(plane, y, loadRow(plane, y) << pixels);
+        }
+    }
+
+    // Colour index (one bit per plane) of the pixel at column x, row y
+    static int pixel(const uint64_t* words, int x, int y) {
+        int colour = 0;
+        for (int p = 0; p < Planes; p++) {
+            colour |= ((words[p * PLANE_WORDS + y * ROW_WORDS + x / 64] >> (63 - x % 64)) & 1) << p;
+        }
+        return colour;
+    }
+};
+
+// Spreads 16 sprite bits over 32, every bit twice: how a low resolution sprite is drawn on the high resolution display
+inline uint32_t doubleBits(uint16_t bits) {
+    uint32_t x = bits;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x | (x << 1);
+}
+
+#endif
@@ -0,0 +1,4 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
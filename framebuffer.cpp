@@ -0,0 +1,147 @@
+#ifndef FRAMEBUFFER_CPP
+#define FRAMEBUFFER_CPP
+
+#include "framebuffer.h"
+
+// Expansion of the packed 1-bit display (one uint64_t per row, bit 63 leftmost) into RGBA8888 pixels,
+// shared by the SDL frontend and the headless image exporters.
+// Each sprite-row byte becomes 8 pixels by broadcasting it, masking one bit per lane and blending
+// the two palette colours on the comparison result, 8 lanes at a time with AVX2 or 4 with SSE2.
+// The kernel is picked at runtime from what the CPU supports, with a scalar fallback everywhere else
+
+// Colours as SDL_PIXELFORMAT_RGBA8888 values (0xRRGGBBAA)
+struct Palette {
+    uint32_t off = 0x00000000;  // Black for OFF pixels
+    uint32_t on = 0xFFFFFFFF;   // White for ON pixels
+    // Colours 2-15 of the XO-CHIP bitplane display, indexed by the plane bits (plane 0 is bit 0)
+    uint32_t extra[14] = {0xFF6600FF, 0x662200FF, 0xFF0000FF, 0x00FF00FF, 0x0000FFFF, 0xFFFF00FF, 0x00FFFFFF,
+                          0xFF00FFFF, 0x808080FF, 0x800000FF, 0x008000FF, 0x000080FF, 0x808000FF, 0x008080FF};
+
+    uint32_t colour(int index) const {
+        return index == 0 ? off : index == 1 ? on : extra[index - 2];
+    }
+};
+
+enum class ExpandKernel { Scalar, SSE2, AVX2 };
+
+inline const char* expandKernelName(ExpandKernel kernel) {
+    switch (kernel) {
+        case ExpandKernel::Scalar: return "scalar";
+        case ExpandKernel::SSE2: return "sse2";
+        case ExpandKernel::AVX2: return "avx2";
+    }
+    return "?";
+}
+
+inline bool expandKernelSupported(ExpandKernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == ExpandKernel::AVX2) return __builtin_cpu_supports("avx2");
+    if (kernel == ExpandKernel::SSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return kernel == ExpandKernel::Scalar;
+}
+
+inline ExpandKernel bestExpandKernel() {
+    static const ExpandKernel best = expandKernelSupported(ExpandKernel::AVX2) ? ExpandKernel::AVX2
+                                   : expandKernelSupported(ExpandKernel::SSE2) ? ExpandKernel::SSE2
+                                   : ExpandKernel::Scalar;
+    return best;
+}
+
+// Expands one 64-pixel row into out[0..63]
+inline void expandRowScalar(uint64_t row, uint32_t* out, const Palette& palette) {
+    for (int x = 0; x < 64; x++) {
+        out[x] = (row >> (63 - x)) & 1 ? palette.on : palette.off;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+inline void expandRowSSE2(uint64_t row, uint32_t* out, const Palette& palette) {
+    const __m128i on = _mm_set1_epi32(palette.on);
+    const __m128i off = _mm_set1_epi32(palette.off);
+    const __m128i highBits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);    // pixels 0-3 of a byte
+    const __m128i lowBits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);     // pixels 4-7
+
+    for (int byte = 0; byte < 8; byte++) {
+        __m128i bits = _mm_set1_epi32((row >> (56 - 8 * byte)) & 0xFF);
+        __m128i high = _mm_cmpeq_epi32(_mm_and_si128(bits, highBits), highBits);
+        __m128i low = _mm_cmpeq_epi32(_mm_and_si128(bits, lowBits), lowBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + byte * 8), _mm_or_si128(_mm_and_si128(high, on), _mm_andnot_si128(high, off)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + byte * 8 + 4), _mm_or_si128(_mm_and_si128(low, on), _mm_andnot_si128(low, off)));
+    }
+}
+
+__attribute__((target("avx2")))
+inline void expandRowAVX2(uint64_t row, uint32_t* out, const Palette& palette) {
+    const __m256i on = _mm256_set1_epi32(palette.on);
+    const __m256i off = _mm256_set1_epi32(palette.off);
+    const __m256i bitMask = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+
+    for (int byte = 0; byte < 8; byte++) {
+        __m256i bits = _mm256_set1_epi32((row >> (56 - 8 * byte)) & 0xFF);
+        __m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(bits, bitMask), bitMask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + byte * 8), _mm256_blendv_epi8(off, on, lit));
+    }
+}
+#endif
+
+inline void expandRow(uint64_t row, uint32_t* out, const Palette& palette, ExpandKernel kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == ExpandKernel::AVX2) return expandRowAVX2(row, out, palette);
+    if (kernel == ExpandKernel::SSE2) return expandRowSSE2(row, out, palette);
+#endif
+    expandRowScalar(row, out, palette);
+}
+
+// Expands rows firstRow..lastRow of 'rows' into 'out', a buffer 'pitch' pixels wide.
+// With scale > 1 every pixel becomes a scale x scale block, row y lands at out[y * scale * pitch]
+inline void expandFramebuffer(const uint64_t* rows, int firstRow, int lastRow, uint32_t* out, int pitch,
+                              const Palette& palette, int scale = 1, ExpandKernel kernel = bestExpandKernel()) {
+    for (int y = firstRow; y <= lastRow; y++) {
+        uint32_t* line = out + (size_t)y * scale * pitch;
+        if (scale == 1) {
+            expandRow(rows[y], line, palette, kernel);
+            continue;
+        }
+
+        uint32_t expanded[64];
+        expandRow(rows[y], expanded, palette, kernel);
+        for (int x = 0; x < 64; x++) {
+            std::fill_n(line + x * scale, scale, expanded[x]);
+        }
+        for (int copy = 1; copy < scale; copy++) {
+            std::memcpy(line + (size_t)copy * pitch, line, 64 * scale * sizeof(uint32_t));
+        }
+    }
+}
+
+// Expands rows firstRow..lastRow of a display made of 'planes' bitplanes, each 'width' pixels by
+// 'height' rows in the DisplayEngine layout, into 'out' (pitch = width). Every pixel looks up the
+// colour its plane bits select, this only runs for XO-CHIP so the plain loop is fast enough
+inline void expandPlanes(const uint64_t* words, int width, int height, int planes, int firstRow, int lastRow,
+                         uint32_t* out, const Palette& palette) {
+    const int rowWords = width / 64;
+    const int planeWords = rowWords * height;
+    uint32_t colours[16];
+    for (int i = 0; i < 16; i++) {
+        colours[i] = palette.colour(i);
+    }
+
+    for (int y = firstRow; y <= lastRow; y++) {
+        uint32_t* line = out + (size_t)y * width;
+        for (int word = 0; word < rowWords; word++) {
+            uint64_t bits[4] = {0};
+            for (int p = 0; p < planes && p < 4; p++) {
+                bits[p] = words[p * planeWords + y * rowWords + word];
+            }
+            for (int x = 0; x < 64; x++) {
+                int shift = 63 - x;
+                int index = (bits[0] >> shift & 1) | (bits[1] >> shift & 1) << 1 | (bits[2] >> shift & 1) << 2 | (bits[3] >> shift & 1) << 3;
+                line[word * 64 + x] = colours[index];
+            }
+        }
+    }
+}
+
+#endif
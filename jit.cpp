@@ -0,0 +1,343 @@
+#ifndef JIT_CPP
+#define JIT_CPP
+
+#include "jit.h"
+#include "chip8.cpp"
+
+// Basic-block recompiler for x86-64.
+// Straight-line runs of CHIP-8 instructions are translated to native code the first time their
+// start address is executed and cached by that address. Register moves, immediates, I and timer
+// updates are emitted inline, the flag-setting ALU ops and other side-effect-free instructions call
+// back into the Chip8 handlers so they can never drift from the interpreter. A block ends at a jump
+// or skip (emitted natively as the new pc) or right before anything that touches the stack, the
+// display, the keypad or memory, which then falls back to the interpreter for that one instruction
+// (so 2NNN and 00EE raise stack faults exactly as interpreted, and execute() stops on them).
+// Blocks overlapping an Fx33/Fx55 write are dropped, so self-modifying ROMs still behave.
+// The code buffer is only mapped on the first compile and is never writable and executable at the
+// same time: it is flipped to read-write to add a block and back to read-execute before running it.
+// On other architectures, or if executable memory can't be mapped, everything is interpreted.
+class Chip8JIT {
+    public:
+        static constexpr int MAX_BLOCK_INSTRUCTIONS = 64;
+        static constexpr size_t CODE_BUFFER_SIZE = 1 << 20;   // flushed completely when full
+
+        Chip8JIT() = default;
+
+        ~Chip8JIT() {
+            if (code) {
+                munmap(code, CODE_BUFFER_SIZE);
+            }
+        }
+
+        Chip8JIT(const Chip8JIT&) = delete;
+        Chip8JIT& operator=(const Chip8JIT&) = delete;
+
+        // False on hosts the recompiler doesn't support, or once executable memory was refused
+        bool enabled() const { return !unavailable; }
+
+        // Drops every compiled block, call this after changing memory outside of Fx33/Fx55 (ROM load, snapshot restore...)
+        void flush() {
+            for (Block& block : blocks) block = Block{};
+            codeUsed = 0;
+        }
+
+        // Same contract as Chip8::executeThreaded(): executes up to 'count' instructions, returns how many ran
+        int execute(Chip8& chip8, int count) {
+            int executed = 0;
+            while (executed < count && chip8.hasMoreOpcodes()) {
+                // Idle loops are fast-forwarded the same way the interpreter does
+                executed += chip8.skipIdle(count - executed);
+                if (executed == count) break;
+
+                Block& block = unavailable ? emptyBlock : lookup(chip8, chip8.pc);
+
+                // Only enter a block if the whole thing fits in the budget, so frames stay instruction-exact
+                if (block.instructions > 0 && executed + block.instructions <= count) {
+                    block.entry(&chip8);
+                    executed += block.instructions;
+                    if (!block.fallsBack || executed == count || !chip8.hasMoreOpcodes()) {
+                        continue;
+                    }
+                }
+
+                interpretOne(chip8);
+                executed++;
+            }
+            return executed;
+        }
+
+        // Same contract as Chip8::runFrame()
+        int runFrame(Chip8& chip8, int cyclesPerFrame) {
+            int executed = execute(chip8, cyclesPerFrame);
+            chip8.cycleCount += executed;
+            chip8.frameCount++;
+            chip8.tickTimers();
+            return executed;
+        }
+
+    private:
+        using BlockEntry = void (*)(Chip8*);
+
+        struct Block {
+            BlockEntry entry = nullptr;
+            uint16_t instructions = 0;  // instructions the native code executes
+            uint16_t bytes = 0;         // bytes of CHIP-8 code covered, including a fallback terminator
+            bool compiled = false;
+            bool fallsBack = false;     // ends right before an instruction that has to be interpreted
+        };
+
+        uint8_t* code = nullptr;
+        size_t codeUsed = 0;
+#if defined(__x86_64__)
+        bool unavailable = false;
+#else
+        bool unavailable = true;
+#endif
+        Block blocks[4096];
+        Block emptyBlock;
+        std::vector<uint8_t> scratch;
+
+        // Executes one instruction with the interpreter, dropping any block it writes over
+        void interpretOne(Chip8& chip8) {
+            uint16_t opcode = (chip8.memory[chip8.pc] << 8) | chip8.memory[(chip8.pc + 1) & Chip8::ADDRESS_MASK];
+            uint8_t opClass = opClassTable.entries[opcode];
+            uint16_t address = chip8.I & Chip8::ADDRESS_MASK;
+
+            chip8.decodeNextOpCode();
+
+            if (opClass == OP_FX33) {
+                invalidate(address, 3);
+            } else if (opClass == OP_FX55) {
+                invalidate(address, opX(opcode) + 1);
+            }
+        }
+
+        // Drops every block overlapping memory[address] to memory[address + length - 1], a range running past
+        // the end of memory wraps to 0 like the interpreter's writes
+        void invalidate(uint32_t address, uint32_t length) {
+            if (address + length > Chip8::MEMORY_SIZE) {
+                invalidate(0, address + length - Chip8::MEMORY_SIZE);
+                length = Chip8::MEMORY_SIZE - address;
+            }
+            uint32_t lowest = address >= MAX_BLOCK_INSTRUCTIONS * 2 + 2 ? address - (MAX_BLOCK_INSTRUCTIONS * 2 + 2) : 0;
+            uint32_t end = address + length;
+            for (uint32_t start = lowest; start < end; start++) {
+                if (blocks[start].compiled && start + blocks[start].bytes > address) {
+                    blocks[start] = Block{};
+                }
+            }
+        }
+
+        Block& lookup(Chip8& chip8, uint16_t pc) {
+            Block& block = blocks[pc & 0x0FFF];
+            if (!block.compiled) {
+                block = compile(chip8, pc);
+            }
+            return block;
+        }
+
+        // --- x86-64 emission, rbx holds the Chip8* for the whole block ---
+
+        static constexpr int32_t V = offsetof(Chip8, registers);
+        static constexpr int32_t INDEX = offsetof(Chip8, I);
+        static constexpr int32_t PC = offsetof(Chip8, pc);
+        static constexpr int32_t DT = offsetof(Chip8, delay_timer);
+        static constexpr int32_t ST = offsetof(Chip8, sound_timer);
+
+        void emit(std::initializer_list<uint8_t> bytes) { scratch.insert(scratch.end(), bytes); }
+        void emit32(uint32_t value) { for (int i = 0; i < 4; i++) scratch.push_back(value >> (8 * i)); }
+        void emit64(uint64_t value) { for (int i = 0; i < 8; i++) scratch.push_back(value >> (8 * i)); }
+
+        // <op> reg, [rbx + disp32]
+        void emitMem(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp) {
+            emit(opcode);
+            scratch.push_back(0x83 | (reg << 3));
+            emit32(disp);
+        }
+
+        void emitLoadByte(uint8_t reg, int32_t disp) { emitMem({0x0F, 0xB6}, reg, disp); }    // movzx r32, byte [rbx+disp]
+        void emitStoreByte(uint8_t reg, int32_t disp) { emitMem({0x88}, reg, disp); }         // mov byte [rbx+disp], r8
+
+        // Calls back into the interpreter handler for one instruction
+        static void callHandler(Chip8* chip8, uint32_t packed) {
+            chip8->execute(DecodedOp{static_cast<uint16_t>(packed), static_cast<uint8_t>(packed >> 16)});
+        }
+
+        void emitCallHandler(uint16_t opcode, uint8_t opClass) {
+            emit({0x48, 0x89, 0xDF});                           // mov rdi, rbx
+            emit({0xBE}); emit32(opcode | (opClass << 16));     // mov esi, packed op
+            emit({0x48, 0xB8}); emit64(reinterpret_cast<uint64_t>(&callHandler)); // mov rax, callHandler
+            emit({0xFF, 0xD0});                                 // call rax
+        }
+
+        // Stores the 16-bit value in eax as the new pc and returns
+        void emitExitWithEax() {
+            emitMem({0x66, 0x89}, 0, PC);                       // mov [rbx+pc], ax
+            emit({0x5B, 0xC3});                                 // pop rbx; ret
+        }
+
+        void emitExit(uint16_t newPC) {
+            emit({0xB8}); emit32(newPC);                        // mov eax, newPC
+            emitExitWithEax();
+        }
+
+        // Skip terminators: flags are already set, pc = equal/notEqual ? address + 4 : address + 2
+        void emitSkipExit(uint16_t address, bool skipIfEqual) {
+            emit({0xB8}); emit32((address + 2) & 0xFFFF);       // mov eax, address + 2
+            emit({0xB9}); emit32((address + 4) & 0xFFFF);       // mov ecx, address + 4
+            emit({0x0F, static_cast<uint8_t>(skipIfEqual ? 0x44 : 0x45), 0xC1}); // cmove/cmovne eax, ecx
+            emitExitWithEax();
+        }
+
+        // Maps the code buffer read-write, blocks are only made executable by writeCode()
+        bool mapCode() {
+            void* buffer = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (buffer == MAP_FAILED) {
+                disable();
+                return false;
+            }
+            code = static_cast<uint8_t*>(buffer);
+            return true;
+        }
+
+        // Copies 'size' bytes of code to code + codeUsed, only the pages it touches are writable meanwhile
+        bool writeCode(const uint8_t* bytes, size_t size) {
+            static const size_t pageSize = sysconf(_SC_PAGESIZE);
+            size_t first = codeUsed / pageSize * pageSize;
+            size_t length = codeUsed + size - first;
+            if (mprotect(code + first, length, PROT_READ | PROT_WRITE) != 0) {
+                disable();
+                return false;
+            }
+            std::memcpy(code + codeUsed, bytes, size);
+            if (mprotect(code + first, length, PROT_READ | PROT_EXEC) != 0) {
+                disable();
+                return false;
+            }
+            return true;
+        }
+
+        // Executable memory was refused (SELinux execmem, PaX...), interpret from now on
+        void disable() {
+            std::cerr << "JIT can't map executable memory, interpreting\n";
+            if (code) {
+                munmap(code, CODE_BUFFER_SIZE);
+                code = nullptr;
+            }
+            flush();
+            unavailable = true;
+        }
+
+        Block compile(Chip8& chip8, uint16_t start) {
+            Block block;
+            block.compiled = true;
+
+#if defined(__x86_64__)
+            scratch.clear();
+            emit({0x53});                                       // push rbx, also realigns the stack for calls
+            emit({0x48, 0x89, 0xFB});                           // mov rbx, rdi
+
+            uint32_t address = start;
+            uint32_t romEnd = 0x200 + chip8.romSize;
+            bool terminated = false;
+
+            while (!terminated && address < romEnd && address + 1 < 4096 && block.instructions < MAX_BLOCK_INSTRUCTIONS) {
+                uint16_t opcode = (chip8.memory[address] << 8) | chip8.memory[address + 1];
+                uint8_t opClass = opClassTable.entries[opcode];
+                uint8_t x = opX(opcode);
+                uint8_t y = opY(opcode);
+                uint8_t nn = opNN(opcode);
+
+                switch (opClass) {
+                    case OP_NONE:
+                        break;
+                    case OP_6XNN:
+                        emitMem({0xC6}, 0, V + x); scratch.push_back(nn);           // mov byte [Vx], NN
+                        break;
+                    case OP_7XNN:
+                        emitMem({0x80}, 0, V + x); scratch.push_back(nn);           // add byte [Vx], NN
+                        break;
+                    case OP_8XY0:
+                        emitLoadByte(0, V + y); emitStoreByte(0, V + x);
+                        break;
+                    case OP_ANNN:
+                        emitMem({0x66, 0xC7}, 0, INDEX); emit({static_cast<uint8_t>(opNNN(opcode)), static_cast<uint8_t>(opNNN(opcode) >> 8)}); // mov word [I], NNN
+                        break;
+                    case OP_FX1E:
+                        emitLoadByte(0, V + x); emitMem({0x66, 0x01}, 0, INDEX);   // add word [I], ax
+                        break;
+                    case OP_FX07:
+                        emitLoadByte(0, DT); emitStoreByte(0, V + x);
+                        break;
+                    case OP_FX15:
+                        emitLoadByte(0, V + x); emitStoreByte(0, DT);
+                        break;
+                    case OP_FX18:
+                        emitLoadByte(0, V + x); emitStoreByte(0, ST);
+                        break;
+
+                    // No control flow and no memory writes, but enough semantics to keep in one place
+                    case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_8XY4: case OP_8XY5:
+                    case OP_8XY6: case OP_8XY7: case OP_8XYE: case OP_CXNN: case OP_FX29: case OP_FX65:
+                        emitCallHandler(opcode, opClass);
+                        break;
+
+                    case OP_1NNN:
+                        emitExit(opNNN(opcode));
+                        terminated = true;
+                        break;
+                    case OP_3XNN:
+                    case OP_4XNN:
+                        emitMem({0x80}, 7, V + x); scratch.push_back(nn);           // cmp byte [Vx], NN
+                        emitSkipExit(address, opClass == OP_3XNN);
+                        terminated = true;
+                        break;
+                    case OP_5XY0:
+                    case OP_9XY0:
+                        emitLoadByte(2, V + x);                                     // movzx edx, byte [Vx]
+                        emitMem({0x3A}, 2, V + y);                                  // cmp dl, byte [Vy]
+                        emitSkipExit(address, opClass == OP_5XY0);
+                        terminated = true;
+                        break;
+
+                    default:
+                        // Interpreter fallback, this instruction is not part of the block
+                        block.fallsBack = true;
+                        terminated = true;
+                        continue;
+                }
+
+                block.instructions++;
+                address += 2;
+            }
+
+            if (!terminated || block.fallsBack) {
+                emitExit(address & 0xFFFF);
+            }
+            block.bytes = (address - start) + (block.fallsBack ? 2 : 0);
+
+            if (block.instructions == 0) {
+                return block;   // nothing worth entering, interpret
+            }
+            if (!code && !mapCode()) {
+                block.instructions = 0;
+                return block;
+            }
+            if (codeUsed + scratch.size() > CODE_BUFFER_SIZE) {
+                flush();
+            }
+            if (!writeCode(scratch.data(), scratch.size())) {
+                block.instructions = 0;
+                return block;
+            }
+            block.entry = reinterpret_cast<BlockEntry>(code + codeUsed);
+            codeUsed += scratch.size();
+#else
+            (void)chip8;
+            (void)start;
+#endif
+            return block;
+        }
+};
+
+#endif
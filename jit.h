@@ -0,0 +1,7 @@
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iostream>
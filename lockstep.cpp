@@ -0,0 +1,635 @@
+#ifndef LOCKSTEP_CPP
+#define LOCKSTEP_CPP
+
+#include "lockstep.h"
+#include "chip8.cpp"
+
+// Many runs of one ROM at once, for seed and input sweeps: LANES CHIP-8 instances whose registers,
+// pc, I, sp, stack, timers and random state are stored structure-of-arrays, one vector per field with
+// an element per lane. While the running lanes are at the same pc (and so on the same instruction),
+// one vector operation executes it for all of them; lanes that went another way on a skip or a key
+// test form groups of their own, and merge back as soon as their pc matches again.
+// Memory, display and keypad stay in a Chip8 per lane. Instructions writing them (DXYN, FX33, FX55,
+// FX0A, ...) go through that lane's own scalar handlers, as does anything the vector kernels don't
+// cover, so each lane ends bit-identical to running its Chip8 alone. On x86 the step loop is compiled
+// for AVX2 and for the baseline ISA and picked at run time, like the framebuffer expansion kernels;
+// elsewhere only the generic one is built and the few SSE2 helpers fall back to plain loops
+
+class LockstepChip8 {
+    public:
+        // One SSE vector of bytes, one AVX2 vector of words. GCC drops vector_size when it depends
+        // on a template parameter, so the width is fixed rather than a template argument
+        static constexpr int LANES = 16;
+
+    private:
+        using Bytes = uint8_t __attribute__((vector_size(LANES)));
+        using Words = uint16_t __attribute__((vector_size(LANES * 2)));
+        using Dwords = uint32_t __attribute__((vector_size(LANES * 4)));
+        using SignedBytes = int8_t __attribute__((vector_size(LANES)));
+        using SignedWords = int16_t __attribute__((vector_size(LANES * 2)));
+        using SignedDwords = int32_t __attribute__((vector_size(LANES * 4)));
+        using Quirks = Chip8::QuirksType;
+        static constexpr Words LANE_BITS = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768};
+
+    public:
+        uint64_t vectorSteps = 0;       // lane instructions the vector kernels executed
+        uint64_t laneSteps = 0;         // lane instructions that went through the lane's own handlers
+
+        // Puts a copy of 'machine' in 'lane', typically the same booted ROM with another seed or input
+        void load(int lane, const Chip8& machine) {
+            lanes[lane] = machine;
+            pull(lane);
+            running[lane] = 0xFFFF;
+            romEnd[lane] = machine.stackFault ? 0 : 0x200 + std::min<size_t>(machine.romSize, 0xFFFF - 0x200);
+            divergedFrom = 0;
+            divergedTo = Chip8::MEMORY_SIZE;
+            aloneFrames = 0;
+            aloneStretch = MIN_ALONE_FRAMES;
+        }
+
+        // The full state of 'lane', registers included
+        Chip8& machine(int lane) {
+            push(lane);
+            return lanes[lane];
+        }
+
+        // Chip8 queries for 'lane' that don't need its registers written back first
+        uint64_t cycleCount(int lane) const {
+            return lanes[lane].cycleCount;
+        }
+
+        bool hasMoreOpcodes(int lane) const {
+            if (inLanes) return lanes[lane].pc < romEnd[lane];
+            return pc[lane] < romEnd[lane];
+        }
+
+        // Only the lane's own handlers run 2NNN and 00EE at the ends of the stack, so the Chip8 always has it
+        bool stackFault(int lane) const {
+            return lanes[lane].stackFault;
+        }
+
+        bool isHalted(int lane) const {
+            if (inLanes) return lanes[lane].isHalted();
+            const uint16_t address = pc[lane];
+            const uint16_t opcode = (lanes[lane].memory[address] << 8) | lanes[lane].memory[(address + 1) & Chip8::ADDRESS_MASK];
+            return (opcode & 0xF000) == 0x1000 && (opcode & 0x0FFF) == address && delay[lane] == 0 && sound[lane] == 0;
+        }
+
+        // Stops running 'lane' (e.g. its budget is spent), its state stays as it is
+        void park(int lane) {
+            running[lane] = 0;
+        }
+
+        // Runs one 60Hz frame on every running lane, lane n executing up to budgets[n] instructions and
+        // then ticking its timers, the same as Chip8::runFrame(budgets[n]) on each lane
+        void runFrame(const uint32_t* budgets) {
+            std::memcpy(&frameBudget, budgets, sizeof(frameBudget));
+            if (aloneFrames > 0) {
+                aloneFrames--;
+                runFrameAlone();
+                return;
+            }
+            if (inLanes) {
+                for (int lane = 0; lane < LANES; lane++) pull(lane);
+                inLanes = false;
+            }
+
+            if (divergedFrom < divergedTo) {
+                narrowDivergence();
+            }
+            // Input only changes between frames, as for runFrame()
+            static const uint8_t pressed[16] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+            static const uint8_t released[16] = {};
+            uint16_t down[LANES], up[LANES];
+            for (int lane = 0; lane < LANES; lane++) {
+                down[lane] = equalBytes(lanes[lane].keypad, pressed);
+                up[lane] = equalBytes(lanes[lane].keypad, released);
+            }
+            std::memcpy(&keysDown, down, sizeof(keysDown));
+            std::memcpy(&keysUp, up, sizeof(keysUp));
+
+            frameGroups = frameGroupLanes = 0;
+#if defined(__x86_64__) || defined(__i386__)
+            if (hasAVX2()) {
+                runFrameAVX2();
+            } else {
+                runFrameGeneric();
+            }
+#else
+            runFrameGeneric();
+#endif
+            // A group costs about what three lanes' instructions do on their own threaded interpreters,
+            // so lanes that went their own ways are better off there for a while, longer each time they
+            // still haven't come back together
+            if (frameGroupLanes < MIN_GROUP_LANES * frameGroups) {
+                aloneFrames = aloneStretch;
+                aloneStretch = std::min(aloneStretch * 2, MAX_ALONE_FRAMES);
+            } else {
+                aloneStretch = MIN_ALONE_FRAMES;
+            }
+        }
+
+        void runFrame(int cyclesPerFrame) {
+            uint32_t budgets[LANES];
+            std::fill_n(budgets, LANES, cyclesPerFrame);
+            runFrame(budgets);
+        }
+
+    private:
+        Chip8 lanes[LANES];             // everything but the fields below, which are only written back by push()
+
+        Bytes V[16] = {};               // V[r][lane] is register Vr of that lane
+        Words I = {};
+        Words pc = {};
+        Bytes sp = {};
+        Words stack[16] = {};
+        Bytes delay = {};
+        Bytes sound = {};
+        Dwords random = {};
+
+        Words running = {};             // 0xFFFF for lanes not parked
+        Words romEnd = {};              // hasMoreOpcodes() bound of each lane, 0 once it hit a stack fault
+        Dwords frameBudget = {};
+        Dwords executed = {};           // instructions each lane ran in the current frame
+        Words keysDown = {};            // keys EX9E sees pressed, a bit per key
+        Words keysUp = {};              // keys EXA1 sees released
+
+        static constexpr int MIN_GROUP_LANES = 3;   // average lanes per group below which a frame didn't pay off
+        static constexpr int MIN_ALONE_FRAMES = 16; // frames then run lane by lane before lockstep is tried again
+        static constexpr int MAX_ALONE_FRAMES = 1024;
+        int aloneFrames = 0;
+        int aloneStretch = MIN_ALONE_FRAMES;
+        bool inLanes = false;           // while running lane by lane the registers live in 'lanes', not the vectors
+        uint64_t frameGroups = 0;       // groups the last lockstep frame executed, and lanes in them
+        uint64_t frameGroupLanes = 0;
+
+        // Lanes' memory can only differ in [divergedFrom, divergedTo), anywhere else an equal pc means an equal instruction
+        uint16_t divergedFrom = 0;
+        uint16_t divergedTo = Chip8::MEMORY_SIZE;
+
+        static bool hasAVX2() {
+#if defined(__x86_64__) || defined(__i386__)
+            static const bool supported = __builtin_cpu_supports("avx2");
+            return supported;
+#else
+            return false;
+#endif
+        }
+
+        // Lane registers from the SoA vectors into the lane's Chip8, and back
+        void push(int lane) {
+            if (inLanes) return;
+            Chip8& chip8 = lanes[lane];
+            for (int r = 0; r < 16; r++) {
+                chip8.registers[r] = V[r][lane];
+                chip8.stack[r] = stack[r][lane];
+            }
+            chip8.I = I[lane];
+            chip8.pc = pc[lane];
+            chip8.sp = sp[lane];
+            chip8.delay_timer = delay[lane];
+            chip8.sound_timer = sound[lane];
+            chip8.randomState = random[lane];
+        }
+
+        // Only what changed is written back: a byte store into a vector the next vector operation loads
+        // whole can't be forwarded, and stalls it
+        void pull(int lane) {
+            const Chip8& chip8 = lanes[lane];
+            auto update = [](auto& vector, auto value, int lane) {
+                if (vector[lane] != value) vector[lane] = value;
+            };
+            for (int r = 0; r < 16; r++) {
+                update(V[r], chip8.registers[r], lane);
+                update(stack[r], chip8.stack[r], lane);
+            }
+            update(I, chip8.I, lane);
+            update(pc, chip8.pc, lane);
+            update(sp, chip8.sp, lane);
+            update(delay, chip8.delay_timer, lane);
+            update(sound, chip8.sound_timer, lane);
+            update(random, chip8.randomState, lane);
+        }
+
+        // A bit per byte of a[0..15] that equals the one in b[0..15]
+        static uint32_t equalBytes(const uint8_t* a, const uint8_t* b) {
+#if defined(__SSE2__)
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+#else
+            uint32_t equal = 0;
+            for (int i = 0; i < 16; i++) {
+                equal |= uint32_t(a[i] == b[i]) << i;
+            }
+            return equal;
+#endif
+        }
+
+        // The bytes of the 16 at 'address' (a multiple of 16) that are the same in every lane, a bit each
+        uint32_t matchingBytes(int address) const {
+            uint32_t matching = 0xFFFF;
+            for (int lane = 1; lane < LANES; lane++) {
+                matching &= equalBytes(lanes[0].memory + address, lanes[lane].memory + address);
+            }
+            return matching;
+        }
+
+        // Shrinks the diverged range to the bytes that really differ between lanes, empty when memory is all the same
+        void narrowDivergence() {
+            while (divergedFrom < divergedTo) {
+                const int block = divergedFrom & ~15;
+                const uint32_t differing = ~matchingBytes(block) & (0xFFFF << (divergedFrom - block)) & 0xFFFF;
+                if (differing) {
+                    divergedFrom = block + __builtin_ctz(differing);
+                    break;
+                }
+                divergedFrom = block + 16;
+            }
+            if (divergedFrom >= divergedTo) {
+                divergedFrom = divergedTo = 0;
+                return;
+            }
+            // The byte at divergedFrom differs, so this stops there at the latest
+            while (true) {
+                const int block = (divergedTo - 1) & ~15;
+                const uint32_t differing = ~matchingBytes(block) & (0xFFFF >> (15 - (divergedTo - 1 - block)));
+                if (differing) {
+                    divergedTo = block + 32 - __builtin_clz(differing);
+                    break;
+                }
+                divergedTo = block;
+            }
+        }
+
+        // Memory writes (FX33, FX55) are the only way lanes' memory can drift apart
+        void wrote(uint16_t address, int length) {
+            if ((size_t)address + length > Chip8::MEMORY_SIZE) {
+                divergedFrom = 0;
+                divergedTo = Chip8::MEMORY_SIZE;
+            } else if (divergedFrom == divergedTo) {
+                divergedFrom = address;
+                divergedTo = address + length;
+            } else {
+                divergedFrom = std::min<uint16_t>(divergedFrom, address);
+                divergedTo = std::max<uint16_t>(divergedTo, address + length);
+            }
+        }
+
+        static uint16_t opcodeAt(const Chip8& chip8, uint16_t address) {
+            if (!(address & 1)) {
+                return chip8.decodeCache[address >> 1].opcode;
+            }
+            return (chip8.memory[address] << 8) | chip8.memory[(address + 1) & Chip8::ADDRESS_MASK];
+        }
+
+        // A lane mask as a bit per lane, LANE_BITS turns it back
+        __attribute__((always_inline)) static inline uint32_t laneBits(const Words& mask) {
+#if defined(__SSE2__)
+            return _mm_movemask_epi8((__m128i)narrow(mask));
+#else
+            uint32_t bits = 0;
+            for (int lane = 0; lane < LANES; lane++) {
+                bits |= uint32_t(mask[lane] & 1) << lane;
+            }
+            return bits;
+#endif
+        }
+
+        // 'target' takes 'value' in the lanes set in 'mask'
+        template <typename Vector>
+        __attribute__((always_inline)) static inline void merge(Vector& target, const Vector& mask, const Vector& value) {
+            target = (value & mask) | (target & ~mask);
+        }
+
+        // A 0xFFFF lane mask to 0xFF. Masks are widened where they are used: a helper returning a 32
+        // or 64 byte vector would have an ABI that depends on AVX, which GCC warns about
+        __attribute__((always_inline)) static inline Bytes narrow(const Words& mask) {
+            return __builtin_convertvector(mask, Bytes);
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        __attribute__((target("avx2"))) void runFrameAVX2() {
+            runFrameImpl();
+        }
+#endif
+
+        void runFrameGeneric() {
+            runFrameImpl();
+        }
+
+        __attribute__((always_inline)) inline void runFrameImpl() {
+            executed = Dwords{};
+            skipIdleLanes();
+            while (step()) {}
+
+            // What Chip8::runFrame() does after the instructions, the timer tick included
+            for (int lane = 0; lane < LANES; lane++) {
+                if (!running[lane]) continue;
+                Chip8& chip8 = lanes[lane];
+                chip8.cycleCount += executed[lane];
+                chip8.frameCount++;
+                chip8.drewThisFrame = false;
+                if (sound[lane] == 1) chip8.beepFlag = true;
+            }
+            // Comparisons are -1 where true
+            Bytes live = narrow(running);
+            merge(delay, live, delay + (Bytes)(delay != 0));
+            merge(sound, live, sound + (Bytes)(sound != 0));
+        }
+
+        // Chip8::runFrame() on every lane. Memory can't be told apart afterwards, any of it may have been written
+        void runFrameAlone() {
+            if (!inLanes) {
+                for (int lane = 0; lane < LANES; lane++) push(lane);
+                inLanes = true;
+            }
+            for (int lane = 0; lane < LANES; lane++) {
+                if (running[lane]) laneSteps += lanes[lane].runFrame(frameBudget[lane]);
+                if (lanes[lane].stackFault) romEnd[lane] = 0;
+            }
+            divergedFrom = 0;
+            divergedTo = Chip8::MEMORY_SIZE;
+        }
+
+        // runFrame() looks for idle loops before its first instruction, lanes starting the frame in one
+        // (typically polling the delay timer) skip it the same way
+        void skipIdleLanes() {
+            for (int lane = 0; lane < LANES; lane++) {
+                if (!running[lane] || pc[lane] >= romEnd[lane] || frameBudget[lane] == 0) continue;
+                const Chip8& chip8 = lanes[lane];
+                const uint16_t opcode = opcodeAt(chip8, pc[lane]);
+                if ((opcode & 0xF000) == 0x1000 && opNNN(opcode) == pc[lane]) {
+                    executed[lane] = frameBudget[lane];
+                    continue;
+                }
+                // Short of a jump to itself, only a key wait or a running delay timer can be idle
+                const bool keyWait = (opcode & 0xF0FF) == 0xF00A && chip8.pressedKey == 0xFF;
+                if (!keyWait && delay[lane] == 0) continue;
+                push(lane);
+                const int skipped = lanes[lane].skipIdle(frameBudget[lane]);
+                if (skipped > 0) {
+                    executed[lane] = skipped;
+                    pull(lane);
+                }
+            }
+        }
+
+        // Executes one instruction on every lane that still has some of its frame budget left, a group of
+        // lanes at a time: the lanes sharing the first remaining lane's pc. Returns false once none has budget
+        __attribute__((always_inline)) inline bool step() {
+            // Signed, AVX2 has no unsigned compare and the counts never reach 2^31
+            const Words underBudget = (Words)__builtin_convertvector((SignedDwords)executed < (SignedDwords)frameBudget, SignedWords);
+            const Words active = running & (Words)(pc < romEnd) & underBudget;
+            uint32_t remaining = laneBits(active);
+            if (!remaining) {
+                return false;
+            }
+
+            while (remaining) {
+                const int leader = __builtin_ctz(remaining);
+                const uint16_t leaderPc = pc[leader];
+                const uint16_t opcode = opcodeAt(lanes[leader], leaderPc);
+
+                uint32_t members = laneBits((Words)(pc == leaderPc)) & remaining;
+                if (leaderPc + 2 > divergedFrom && leaderPc < divergedTo) {
+                    for (uint32_t others = members & (members - 1); others; others &= others - 1) {
+                        int lane = __builtin_ctz(others);
+                        if (opcodeAt(lanes[lane], leaderPc) != opcode) members &= ~(1u << lane);
+                    }
+                }
+                remaining &= ~members;
+                frameGroups++;
+                frameGroupLanes += __builtin_popcount(members);
+
+                const uint8_t opClass = opClassTable.entries[opcode];
+                const Words group = (Words)(((Words{} + (uint16_t)members) & LANE_BITS) != 0);
+                if (opClass == OP_1NNN && opNNN(opcode) == leaderPc) {
+                    // A jump to itself spins there for the rest of the frame, skipped the way Chip8::skipIdle() does
+                    merge(executed, (Dwords)__builtin_convertvector((SignedWords)group, SignedDwords), frameBudget - 1);
+                    vectorSteps += __builtin_popcount(members);
+                } else if (executeVector(opcode, opClass, group, leader)) {
+                    vectorSteps += __builtin_popcount(members);
+                } else {
+                    executeAlone(members, opcode, opClass);
+                }
+            }
+            executed += (Dwords)__builtin_convertvector((SignedWords)active, SignedDwords) & 1;
+            return true;
+        }
+
+        // 'opcode' (the one every lane in 'members' is at) through each lane's own Chip8
+        void executeAlone(uint32_t members, uint16_t opcode, uint8_t opClass) {
+            for (; members; members &= members - 1) {
+                const int lane = __builtin_ctz(members);
+                Chip8& chip8 = lanes[lane];
+                laneSteps++;
+
+                // Draws are most of what runs here, they only need the registers they read written back
+                if (opClass == OP_DXYN) {
+                    chip8.pc = pc[lane];
+                    chip8.I = I[lane];
+                    chip8.registers[opX(opcode)] = V[opX(opcode)][lane];
+                    chip8.registers[opY(opcode)] = V[opY(opcode)][lane];
+                    const int skipped = chip8.skipIdle(frameBudget[lane] - executed[lane]);
+                    if (skipped > 0) {
+                        executed[lane] += skipped - 1;
+                        continue;
+                    }
+                    chip8.decodeNextOpCode();
+                    pc[lane] = chip8.pc;
+                    V[0xF][lane] = chip8.registers[0xF];
+                    continue;
+                }
+
+                push(lane);
+                const uint16_t address = chip8.I;
+
+                // The lane alone may be in an idle loop its group isn't in, fast-forward it like runFrame() does
+                int skipped = chip8.skipIdle(frameBudget[lane] - executed[lane]);
+                if (skipped > 0) {
+                    executed[lane] += skipped - 1;
+                    pull(lane);
+                    continue;
+                }
+                chip8.decodeNextOpCode();
+                pull(lane);
+                if (chip8.stackFault) romEnd[lane] = 0;     // stops the lane as hasMoreOpcodes() stops runFrame()
+
+                if (opClass == OP_FX33) {
+                    wrote(address, 3);
+                } else if (opClass == OP_FX55) {
+                    wrote(address, opX(opcode) + 1);
+                }
+            }
+        }
+
+        // Executes 'opcode' for every lane in 'mask' with vector operations, mirroring the Chip8 handlers
+        // (and the quirks Chip8 is built with). Returns false for anything left to executeAlone()
+        __attribute__((always_inline)) inline bool executeVector(uint16_t opcode, uint8_t opClass, const Words& mask, int leader) {
+            const uint8_t x = opX(opcode);
+            const uint8_t y = opY(opcode);
+            const uint8_t nn = opNN(opcode);
+            const uint16_t nnn = opNNN(opcode);
+            const Bytes byteMask = narrow(mask);
+
+            switch (opClass) {
+                case OP_2NNN:
+                    for (int lane = 0; lane < LANES; lane++) {
+                        if (mask[lane] && sp[lane] >= 15) return false;     // a stack fault, left to the scalar handler
+                    }
+                    break;
+                case OP_00EE:
+                    for (int lane = 0; lane < LANES; lane++) {
+                        if (mask[lane] && sp[lane] == 0) return false;
+                    }
+                    break;
+                case OP_FX65: {
+                    // Only the common case of one I for the whole group, reading memory no lane has changed
+                    const uint16_t address = I[leader];
+                    if ((laneBits((Words)(I == address)) & laneBits(mask)) != laneBits(mask)
+                        || address + x >= Chip8::MEMORY_SIZE || (address + x >= divergedFrom && address < divergedTo)) {
+                        return false;
+                    }
+                    break;
+                }
+                case OP_NONE: case OP_1NNN: case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+                case OP_6XNN: case OP_7XNN: case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3:
+                case OP_8XY4: case OP_8XY5: case OP_8XY6: case OP_8XY7: case OP_8XYE: case OP_ANNN:
+                case OP_BNNN: case OP_CXNN: case OP_EX9E: case OP_EXA1: case OP_FX07: case OP_FX15: case OP_FX18: case OP_FX1E: case OP_FX29:
+                    break;
+                default:
+                    return false;
+            }
+
+            merge(pc, mask, pc + 2);
+            switch (opClass) {
+                case OP_NONE:
+                    break;
+                case OP_00EE:
+                    for (int lane = 0; lane < LANES; lane++) {
+                        if (!mask[lane]) continue;
+                        pc[lane] = stack[sp[lane]][lane];
+                        sp[lane]--;
+                    }
+                    break;
+                case OP_1NNN:
+                    merge(pc, mask, Words{} + nnn);
+                    break;
+                case OP_2NNN:
+                    for (int lane = 0; lane < LANES; lane++) {
+                        if (!mask[lane]) continue;
+                        sp[lane]++;
+                        stack[sp[lane]][lane] = pc[lane];
+                        pc[lane] = nnn;
+                    }
+                    break;
+                case OP_3XNN:
+                    pc += (Words)__builtin_convertvector(V[x] == nn, SignedWords) & mask & 2;
+                    break;
+                case OP_4XNN:
+                    pc += (Words)__builtin_convertvector(V[x] != nn, SignedWords) & mask & 2;
+                    break;
+                case OP_5XY0:
+                    pc += (Words)__builtin_convertvector(V[x] == V[y], SignedWords) & mask & 2;
+                    break;
+                case OP_9XY0:
+                    pc += (Words)__builtin_convertvector(V[x] != V[y], SignedWords) & mask & 2;
+                    break;
+                case OP_6XNN:
+                    merge(V[x], byteMask, Bytes{} + nn);
+                    break;
+                case OP_7XNN:
+                    merge(V[x], byteMask, V[x] + nn);
+                    break;
+                case OP_8XY0:
+                    merge(V[x], byteMask, V[y]);
+                    break;
+                case OP_8XY1:
+                case OP_8XY2:
+                case OP_8XY3: {
+                    Bytes result = opClass == OP_8XY1 ? V[x] | V[y] : opClass == OP_8XY2 ? V[x] & V[y] : V[x] ^ V[y];
+                    merge(V[x], byteMask, result);
+                    if constexpr (Quirks::VF_RESET) merge(V[0xF], byteMask, Bytes{});
+                    break;
+                }
+                case OP_8XY4: {
+                    Bytes sum = V[x] + V[y];
+                    Bytes carry = (Bytes)(sum < V[x]) & 1;
+                    merge(V[x], byteMask, sum);
+                    merge(V[0xF], byteMask, carry);
+                    break;
+                }
+                case OP_8XY5:
+                case OP_8XY7: {
+                    Bytes a = opClass == OP_8XY5 ? V[x] : V[y];
+                    Bytes b = opClass == OP_8XY5 ? V[y] : V[x];
+                    Bytes flag = (Bytes)(a >= b) & 1;
+                    merge(V[x], byteMask, a - b);
+                    merge(V[0xF], byteMask, flag);
+                    break;
+                }
+                case OP_8XY6:
+                case OP_8XYE: {
+                    if constexpr (!Quirks::SHIFT_VX) merge(V[x], byteMask, V[y]);
+                    Bytes flag = opClass == OP_8XY6 ? V[x] & 1 : V[x] >> 7;
+                    merge(V[x], byteMask, opClass == OP_8XY6 ? V[x] >> 1 : V[x] << 1);
+                    merge(V[0xF], byteMask, flag);
+                    break;
+                }
+                case OP_ANNN:
+                    merge(I, mask, Words{} + nnn);
+                    break;
+                case OP_BNNN:
+                    merge(pc, mask, __builtin_convertvector(V[Quirks::JUMP_VX ? x : 0], Words) + nnn);
+                    break;
+                case OP_CXNN: {
+                    Dwords next = random;
+                    next ^= next << 13;
+                    next ^= next >> 17;
+                    next ^= next << 5;
+                    merge(random, (Dwords)__builtin_convertvector((SignedWords)mask, SignedDwords), next);
+                    merge(V[x], byteMask, __builtin_convertvector(next >> 24, Bytes) & nn);
+                    break;
+                }
+                case OP_EX9E:
+                case OP_EXA1: {
+                    // In 32 bits, AVX2 only has per-element shifts for those
+                    Dwords key = __builtin_convertvector(V[x] & 0x0F, Dwords);
+                    Dwords keys = __builtin_convertvector(opClass == OP_EX9E ? keysDown : keysUp, Dwords);
+                    pc += __builtin_convertvector((keys >> key) & 1, Words) * 2 & mask;
+                    break;
+                }
+                case OP_FX07:
+                    merge(V[x], byteMask, delay);
+                    break;
+                case OP_FX15:
+                    merge(delay, byteMask, V[x]);
+                    break;
+                case OP_FX18:
+                    merge(sound, byteMask, V[x]);
+                    break;
+                case OP_FX1E:
+                    merge(I, mask, I + __builtin_convertvector(V[x], Words));
+                    break;
+                case OP_FX29:
+                    merge(I, mask, __builtin_convertvector(V[x] & 0x0F, Words) * 5);
+                    break;
+                case OP_FX65: {
+                    const uint8_t* memory = lanes[leader].memory + I[leader];
+                    for (int r = 0; r <= x; r++) {
+                        merge(V[r], byteMask, Bytes{} + memory[r]);
+                    }
+                    if constexpr (Quirks::MEMORY == IndexIncrement::X) {
+                        merge(I, mask, I + x);
+                    } else if constexpr (Quirks::MEMORY == IndexIncrement::XPlusOne) {
+                        merge(I, mask, I + x + 1);
+                    }
+                    break;
+                }
+            }
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,6 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
@@ -1,117 +1,482 @@
 #include "chip8.h"
 #include "chip8.cpp"
+#include "framebuffer.h"
+#include "framebuffer.cpp"
+#include "sdl_frontend.h"
+#include "sdl_frontend.cpp"
+#include "audio.h"
+#include "audio.cpp"
+#include "jit.h"
+#include "jit.cpp"
+#include "lockstep.h"
+#include "lockstep.cpp"
+#include "romcache.h"
+#include "romcache.cpp"
+#include "batch.h"
+#include "batch.cpp"
+#include "snapshot.h"
+#include "snapshot.cpp"
+#include "rewind.h"
+#include "rewind.cpp"
+#include "movie.h"
+#include "movie.cpp"
+#include "scheduler.h"
+#include "scheduler.cpp"
+#include "pipeline.h"
+#include "pipeline.cpp"
+#include "capture.h"
+#include "capture.cpp"
+#include <charconv>
 
-int main(int argc, char *argv[]) {
-    Chip8 chip8; // emulator instance
-    
-    // Load font set into memory (at location 0x000 to 0x050)
-    // Each character is 5 bytes
-    // This is not very elegant but this instruction is so boring to code I just want to get it over with
-    uint8_t fontset[80] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-    };
-    
-    // Load fontset into memory
-    for (int i = 0; i < 80; ++i) {
-        chip8.memory[i] = fontset[i];
+// Run options, filled in from the command line
+struct Options {
+    std::string romPath = "assets/ROMS/5-quirks.ch8"; // Default ROM
+    bool maxSpeed = false;        // --max-speed: run as fast as the host allows, timers follow instruction count
+    bool headless = false;        // --headless: never touch SDL, useful together with --max-speed
+    bool useJIT = false;          // --jit: run through the x86-64 basic-block recompiler
+    uint64_t cycleLimit = 0;      // --cycles N: stop after N instructions (0 = no limit)
+    int cyclesPerFrame = 500 / 60; // --cycles-per-frame N: instructions per 60Hz frame (~500Hz CPU by default)
+    uint32_t seed = 0;            // --seed N: CXNN random seed
+    std::string batchPath;        // --batch DIR|MANIFEST: run many ROMs headless across all cores
+    unsigned threads = 0;         // --threads N: batch workers (0 = one per core)
+    unsigned sweep = 0;           // --sweep N: batch runs every ROM with N seeds from its own up, in lockstep
+    std::string loadStatePath;    // --load-state PATH: resume from a snapshot instead of booting the ROM
+    std::string saveStatePath;    // --save-state PATH: write a snapshot on exit
+    size_t rewindMegabytes = 0;   // --rewind MB: keep that much per-frame history, hold Backspace to step back
+    std::string recordPath;       // --record PATH: log input to a movie file
+    std::string replayPath;       // --replay PATH: replay a movie headless at full speed and check the final frame
+    float tonePitch = 440.0f;     // --tone HZ: beeper pitch
+    float toneVolume = 0.25f;     // --volume PERCENT: beeper volume, 0 leaves the audio device closed
+    std::string profilePath;      // --profile PREFIX: write PREFIX.txt and PREFIX.folded (needs 'make profile')
+    std::string model;            // --model chip8|schip|xochip: machine to emulate, by default the one the quirks are for
+    std::string quirks;           // --quirks vip|chip48|schip|xochip: behaviour profile, by default the model's own
+    std::string exportPath;       // --export PATH: write every display change as PATH-<frame>.pbm/.pgm/.png, or as raw RGB24 to a file, FIFO or - (stdout)
+};
+
+// Everything after option parsing, for one machine model
+template <typename Machine>
+int runMachine(Options options, SDLFrontend& frontend) {
+    Machine chip8; // emulator instance
+
+    // The JIT and snapshots only know the CHIP-8 layout
+    constexpr bool CLASSIC = std::is_same<Machine, Chip8>::value;
+    if (!CLASSIC && (options.useJIT || !options.loadStatePath.empty() || !options.saveStatePath.empty())) {
+        std::cout << "--jit, --load-state and --save-state only support the chip8 model with the vip quirks, ignored\n";
+        options.useJIT = false;
+        options.loadStatePath.clear();
+        options.saveStatePath.clear();
     }
+
+    // A replay brings its own seed and frame length and runs unattended
+    MoviePlayer player;
+    bool replaying = !options.replayPath.empty();
+    if (replaying) {
+        if (!player.open(options.replayPath)) {
+            return 1;
+        }
+        options.seed = player.seed;
+        options.cyclesPerFrame = player.cyclesPerFrame;
+        options.headless = true;
+        options.maxSpeed = true;
+    }
+
+    // Load font set into memory (at location 0x000 to 0x050, the big font follows on SUPER-CHIP and XO-CHIP)
+    chip8.loadFontset();
+    chip8.seedRandom(options.seed);
     
     // Initialize SDL
-    if (!chip8.initializeSDL()) {
+    if (!options.headless && !frontend.initializeSDL()) {
         std::cerr << "Failed to initialize SDL. Exiting..." << std::endl;
         return 1;
     }
 
-    // Determine ROM file to load
-    std::string romPath = "assets/ROMS/5-quirks.ch8"; // Default ROM
-    
-    // If a ROM file is specified as a command line argument, use it instead
-    if (argc > 1) {
-        romPath = argv[1];
+    if (!options.loadStatePath.empty()) {
+        // The snapshot carries memory, ROM included, and every register
+        std::cout << "Loading snapshot: " << options.loadStatePath << std::endl;
+        if constexpr (CLASSIC) {
+            if (!loadSnapshot(options.loadStatePath, chip8)) {
+                if (!options.headless) frontend.cleanupSDL();
+                return 1;
+            }
+        }
+    } else {
+        std::cout << "Loading ROM: " << options.romPath << std::endl;
+        
+        // Load the ROM file
+        if (!chip8.loadROM(options.romPath)) {
+            if (!options.headless) frontend.cleanupSDL();
+            return 1;
+        }
+        std::cout << "ROM loaded into memory at 0x200\n";
     }
-    
-    std::cout << "Loading ROM: " << romPath << std::endl;
-    
-    // Load the ROM file
-    std::fstream inputStream(romPath, std::ios::in | std::ios::binary | std::ios::ate);
 
-    if (!inputStream.is_open()) {
-        std::cout << "Problem reading file\n";
-        chip8.cleanupSDL();
+
+    
+    if (replaying && (romHash(chip8) != player.expectedRomHash || chip8.frameCount != player.startFrame)) {
+        std::cerr << "Movie " << options.replayPath << " was recorded on another ROM or from another state\n";
         return 1;
     }
 
-    chip8.romSize = inputStream.tellg();    
-    inputStream.seekg(0, std::ios::beg);
+    MovieRecorder recorder;
+    if (!options.recordPath.empty()) {
+        if (!recorder.open(options.recordPath, chip8, options.seed, options.cyclesPerFrame)) {
+            if (!options.headless) frontend.cleanupSDL();
+            return 1;
+        }
+        if (options.rewindMegabytes > 0) {
+            std::cout << "Rewind is disabled while recording a movie\n";
+            options.rewindMegabytes = 0;
+        }
+    }
 
-    if (chip8.romSize > 0 && chip8.romSize <= (4096 - 0x200)) {
-        inputStream.read(reinterpret_cast<char*>(&chip8.memory[0x200]), chip8.romSize);
-    } else {
-        std::cout << "ROM too big or empty\n";
-        inputStream.close();
-        chip8.cleanupSDL();
+    BasicRewindBuffer<Machine> rewind(options.rewindMegabytes << 20);
+    if (options.rewindMegabytes > 0) {
+        rewind.record(chip8);
+    }
+
+    // Frames go out on the capture's own thread, an unthrottled run waits for it rather than drop any
+    FrameCapture capture;
+    if (!options.exportPath.empty() && !capture.open(options.exportPath, chip8, frontend.palette, options.maxSpeed)) {
+        if (!options.headless) frontend.cleanupSDL();
         return 1;
     }
 
-    inputStream.close();
-    std::cout << "ROM loaded into memory at 0x200\n";
+    // Audio only follows real time, an unthrottled run stays silent
+    SquareWaveAudio audio;
+    bool sound = !options.headless && !options.maxSpeed && options.toneVolume > 0 && audio.open(options.tonePitch, options.toneVolume);
+
+#ifdef CHIP8_PROFILE
+    // Only the interpreter is instrumented, compiled blocks would bypass the hooks
+    Chip8Profile profile(Machine::MEMORY_SIZE);
+    if (!options.profilePath.empty()) {
+        if (options.useJIT) {
+            std::cout << "Profiling runs the interpreter, --jit ignored\n";
+            options.useJIT = false;
+        }
+    }
+#else
+    if (!options.profilePath.empty()) {
+        std::cout << "Built without profiling support, use 'make profile' for --profile\n";
+    }
+#endif
 
+    // Only built for --jit, an interpreted session never maps code memory
+    std::unique_ptr<Chip8JIT> jit(options.useJIT ? new Chip8JIT() : nullptr);
+    if (jit && !jit->enabled()) {
+        std::cout << "JIT not available on this host, interpreting\n";
+    }
 
-    
     // --- Timing setup ---
-    using clock = std::chrono::high_resolution_clock;
-    auto lastTimerTick = clock::now();
-    auto lastCycleTick = clock::now();
-    const std::chrono::duration<double> timerInterval(1.0 / 60.0);    // 60Hz for timers
-    const std::chrono::duration<double> cycleInterval(1.0 / 500.0);   // CPU speed (~500Hz)
-
-    // --- Main loop ---
-    bool running = true;
-    while (running && chip8.hasMoreOpcodes()) {
-        // Process user input
-        chip8.handleInput();
-        
-        // Execute CPU cycles at the target rate
-        auto currentTime = clock::now();
-        if (currentTime - lastCycleTick >= cycleInterval) {
-            chip8.decodeNextOpCode();
-            lastCycleTick = currentTime;
+    using clock = FrameScheduler::clock;
+    const auto frameInterval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / 60.0)); // 60Hz frames
+    auto startTime = clock::now();
+    FrameScheduler scheduler(60.0);
+
+    // With a window, emulation runs on its own thread and SDL (input, presenting) stays on this one,
+    // so a present blocking on vsync never holds up emulation. Frames go out through a triple buffer
+    // and keypad changes come back through a queue, headless runs just emulate on this thread
+    TripleBuffer<VideoFrame> video;
+    SpscQueue<InputState, 64> inputQueue;
+    std::atomic<bool> stopEmulation{false};
+    std::atomic<bool> emulationDone{false};
+
+    // --- Emulation loop ---
+    // One iteration is one emulated frame: a batch of 'cyclesPerFrame' instructions and a single timer tick,
+    // input only changes and video is only published at those frame boundaries.
+    // Throttled, frames follow the scheduler's deadlines, falling behind they run back to back to catch up
+    auto emulate = [&]() {
+#ifdef CHIP8_PROFILE
+        activeProfile = options.profilePath.empty() ? nullptr : &profile;   // the hooks look at this thread's profile
+#endif
+        bool rewindHeld = false;
+        while (!stopEmulation.load(std::memory_order_relaxed) && chip8.hasMoreOpcodes() && !(replaying && player.finished(chip8))) {
+            InputState input;
+            while (inputQueue.pop(input)) {
+                if (input.keypad != chip8.keypadMask()) chip8.setKeypadMask(input.keypad);
+                rewindHeld = input.rewindHeld;
+            }
+
+            if (options.rewindMegabytes > 0 && rewindHeld) {
+                // Play the recorded frames backwards, memory may go back to before a self-modifying write
+                if (rewind.stepBack(chip8) && jit) jit->flush();
+            } else {
+                // Input only ever changes between frames, which is what makes movies replayable
+                if (replaying) player.frame(chip8);
+                if (recorder.isOpen()) recorder.frame(chip8);
+
+                if (jit) {
+                    if constexpr (CLASSIC) jit->runFrame(chip8, options.cyclesPerFrame);
+                } else {
+                    chip8.runFrame(options.cyclesPerFrame);
+                }
+                if (options.rewindMegabytes > 0) rewind.record(chip8);
+            }
+
+            // Publish only when the display actually changed, the SDL thread shows the newest one
+            if (chip8.dirtyRows && (!options.headless || capture.isOpen())) {
+                if (capture.isOpen()) capture.frame(chip8);
+                if (!options.headless) {
+                    VideoFrame& frame = video.writeSlot();
+                    std::copy_n(chip8.gfx, Machine::Display::WORDS, frame.rows);
+                    frame.frame = chip8.frameCount;
+                    frame.width = Machine::Display::WIDTH;
+                    frame.height = Machine::Display::HEIGHT;
+                    frame.planes = Machine::Display::PLANES;
+                    video.publish();
+                    frontend.wake();
+                }
+                chip8.dirtyRows = 0;
+            }
+
+            // The tone plays for as long as the sound timer runs
+            if (sound) audio.setTone(chip8.sound_timer > 0);
+            if constexpr (Machine::ModelType::XO_CHIP) {
+                // once a program has loaded a pattern it plays instead of the square wave
+                const uint8_t* pattern = chip8.audioPattern;
+                if (sound && std::any_of(pattern, pattern + 16, [](uint8_t byte) { return byte != 0; })) {
+                    audio.setPattern(pattern, 4000.0f * std::pow(2.0f, (chip8.pitch - 64) / 48.0f));
+                }
+            }
+            chip8.beepFlag = false;
+
+            if (options.cycleLimit != 0 && chip8.cycleCount >= options.cycleLimit) {
+                break;
+            }
+
+            // Sleep until the next frame is due, unless running unthrottled or behind schedule
+            if (!options.maxSpeed && !scheduler.frameDone()) {
+                scheduler.sleepUntilDue();
+            }
         }
+        emulationDone.store(true);
+        if (!options.headless) frontend.wake();
+    };
 
-        // Handle 60Hz ticking of delay and sound timers
-        if (currentTime - lastTimerTick >= timerInterval) {
-            if (chip8.delay_timer > 0) chip8.delay_timer--;
-            if (chip8.sound_timer > 0) {
-                if (chip8.sound_timer == 1) {
-                    // Beep sound would go here
-                    std::cout << "BEEP!" << std::endl;
+    if (options.headless) {
+        emulate();
+    } else {
+        std::thread emulation(emulate);
+
+        // --- SDL loop ---
+        // Sleeps in SDL's event wait until input arrives or the emulation thread wakes it with a new
+        // frame, presents at most once per 60Hz interval however fast frames are produced
+        InputState sent;
+        auto nextPresent = clock::now();
+        while (!emulationDone.load()) {
+            // With a frame waiting only until it may be presented, otherwise until the next wake()
+            int timeoutMs = 100;
+            if (frontend.wakePending.load()) {
+                timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(nextPresent - clock::now()).count();
+            }
+            frontend.waitForEvents(std::max(timeoutMs, 1));
+            if (!frontend.pollInput()) {
+                break;
+            }
+
+            // A full queue means emulation is stalled, the change is sent again on the next wakeup
+            InputState input{frontend.keyMask, frontend.rewindHeld};
+            if (input != sent && inputQueue.push(input)) {
+                sent = input;
+            }
+
+            if (clock::now() >= nextPresent) {
+                frontend.frameHandled();
+                if (video.consume()) {
+                    const VideoFrame& frame = video.readSlot();
+                    if (!frontend.setMode(frame.width, frame.height, frame.planes)) {
+                        break;
+                    }
+                    frontend.present(frame.rows, ~uint64_t(0));
+                    // Absolute 60Hz deadlines, after a stall the missed ones are skipped rather than caught up on
+                    auto now = clock::now();
+                    nextPresent += frameInterval;
+                    if (nextPresent <= now) {
+                        nextPresent += ((now - nextPresent) / frameInterval + 1) * frameInterval;
+                    }
                 }
-                chip8.sound_timer--;
             }
-            lastTimerTick = currentTime;
         }
-        
-        // Limit the frame rate
-        SDL_Delay(1);
+
+        stopEmulation.store(true);
+        emulation.join();
+    }
+
+    if (options.maxSpeed) {
+        std::chrono::duration<double> elapsed = clock::now() - startTime;
+        std::cout << "Executed " << std::dec << chip8.cycleCount << " instructions in " << elapsed.count() << " s ("
+                  << std::fixed << std::setprecision(0) << (elapsed.count() > 0 ? chip8.cycleCount / elapsed.count() : 0.0)
+                  << " instructions/s), " << chip8.frameCount << " frames emulated\n";
+    }
+
+    if (chip8.stackFault) {
+        std::cerr << "Stopped on a stack fault: 2NNN with the stack full or 00EE with it empty\n";
+    }
+
+    int exitCode = 0;
+    if (capture.isOpen()) {
+        if (!capture.close()) exitCode = 1;
+        std::cout << "Exported " << std::dec << capture.written() << " frames to " << options.exportPath;
+        if (capture.dropped() > 0) std::cout << ", " << capture.dropped() << " dropped with the writer behind";
+        std::cout << "\n";
+    }
+    if (recorder.isOpen() && recorder.finish(chip8)) {
+        std::cout << "Movie written to " << options.recordPath << "\n";
+    }
+    if (replaying) {
+        if (chip8.frameCount == player.endFrame && chip8.framebufferHash() == player.expectedFramebufferHash) {
+            std::cout << "Replay matches the recording at frame " << std::dec << chip8.frameCount << "\n";
+        } else {
+            std::cout << "Replay diverged: frame " << std::dec << chip8.frameCount << " hash " << std::hex << chip8.framebufferHash()
+                      << ", recorded frame " << std::dec << player.endFrame << " hash " << std::hex << player.expectedFramebufferHash << std::dec << "\n";
+            exitCode = 1;
+        }
+    }
+
+#ifdef CHIP8_PROFILE
+    if (!options.profilePath.empty()) {
+        std::ofstream report(options.profilePath + ".txt");
+        std::ofstream folded(options.profilePath + ".folded");
+        profile.writeReport(report, chip8.memory);
+        profile.writeCollapsed(folded);
+        std::cout << "Profile written to " << options.profilePath << ".txt and " << options.profilePath << ".folded\n";
+    }
+#endif
+
+    if constexpr (CLASSIC) {
+        if (!options.saveStatePath.empty() && saveSnapshot(options.saveStatePath, chip8)) {
+            std::cout << "Snapshot written to " << options.saveStatePath << "\n";
+        }
     }
 
     // Clean up SDL resources before exit
-    chip8.cleanupSDL();
-    return 0;
+    audio.close();
+    if (!options.headless) frontend.cleanupSDL();
+    return exitCode;
+}
+
+// Parses all of 'text' as a number, false if it is empty, has anything after the number or doesn't fit in T
+template <typename T>
+bool parseNumber(const std::string& text, T& value, int base = 10) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result result;
+    if constexpr (std::is_floating_point<T>::value) {
+        result = std::from_chars(text.data(), end, value);
+    } else {
+        result = std::from_chars(text.data(), end, value, base);
+    }
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
 }
 
+void printUsage() {
+    std::cerr << "Usage: chip8_emulator [ROM] [--max-speed] [--headless] [--jit] [--cycles N] [--cycles-per-frame N] [--seed N]\n"
+              << "                      [--batch DIR|MANIFEST] [--threads N] [--sweep N] [--load-state PATH] [--save-state PATH]\n"
+              << "                      [--rewind MB] [--record PATH] [--replay PATH] [--tone HZ] [--volume PERCENT] [--profile PREFIX]\n"
+              << "                      [--model chip8|schip|xochip] [--quirks vip|chip48|schip|xochip] [--export PATH] [--palette OFF,ON]\n";
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    SDLFrontend frontend; // window, renderer and keyboard, the core itself knows nothing about SDL
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool valid = true;      // cleared by a numeric option that isn't a number
+        if (arg == "--max-speed") {
+            options.maxSpeed = true;
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--palette" && i + 1 < argc) {
+            // OFF,ON as RRGGBBAA hex, e.g. 000000FF,33FF66FF
+            std::string colours = argv[++i];
+            size_t comma = colours.find(',');
+            valid = comma != std::string::npos && parseNumber(colours.substr(0, comma), frontend.palette.off, 16)
+                && parseNumber(colours.substr(comma + 1), frontend.palette.on, 16);
+        } else if (arg == "--jit") {
+            options.useJIT = true;
+        } else if (arg == "--cycles" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.cycleLimit);
+        } else if (arg == "--cycles-per-frame" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.cyclesPerFrame);
+            options.cyclesPerFrame = std::max(1, options.cyclesPerFrame);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.seed);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            options.batchPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.threads);
+        } else if (arg == "--sweep" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.sweep);
+        } else if (arg == "--load-state" && i + 1 < argc) {
+            options.loadStatePath = argv[++i];
+        } else if (arg == "--save-state" && i + 1 < argc) {
+            options.saveStatePath = argv[++i];
+        } else if (arg == "--rewind" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.rewindMegabytes);
+        } else if (arg == "--record" && i + 1 < argc) {
+            options.recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        } else if (arg == "--tone" && i + 1 < argc) {
+            // The square wave advances by pitch / sample rate per sample, NaN or a negative pitch has no meaning there
+            valid = parseNumber(argv[++i], options.tonePitch) && std::isfinite(options.tonePitch) && options.tonePitch > 0;
+        } else if (arg == "--volume" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], options.toneVolume) && std::isfinite(options.toneVolume);
+            options.toneVolume /= 100.0f;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            options.profilePath = argv[++i];
+        } else if (arg == "--model" && i + 1 < argc) {
+            options.model = argv[++i];
+        } else if (arg == "--quirks" && i + 1 < argc) {
+            options.quirks = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            options.exportPath = argv[++i];
+        } else {
+            // If a ROM file is specified as a command line argument, use it instead
+            options.romPath = arg;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << "\n";
+            printUsage();
+            return 2;
+        }
+    }
+
+    // A raw stream on stdout needs it to itself before anything else is printed
+    if (options.exportPath == "-") {
+        rawStdout();
+    }
+
+    // Batch mode never touches SDL, every ROM gets its own headless instance
+    if (!options.batchPath.empty()) {
+        if (!options.model.empty() || !options.quirks.empty()) {
+            std::cout << "Batch mode runs the chip8 model with the vip quirks only\n";
+        }
+        uint64_t budget = options.cycleLimit != 0 ? options.cycleLimit : 10000000;
+        std::vector<BatchJob> jobs = loadBatchJobs(options.batchPath, budget, options.seed);
+        if (jobs.empty()) {
+            std::cerr << "No ROMs to run in " << options.batchPath << "\n";
+            return 1;
+        }
+        if (options.sweep > 0) {
+            jobs = sweepBatchJobs(jobs, options.sweep);
+        }
+        return runBatch(jobs, options.threads, options.cyclesPerFrame, options.useJIT, options.sweep > 0) == 0 ? 0 : 1;
+    }
+
+    // Every supported model and quirks pairing is its own instantiation of the interpreter
+    if (options.model.empty()) {
+        options.model = options.quirks == "schip" || options.quirks == "xochip" ? options.quirks : "chip8";
+    }
+    if (options.model == "chip8" && (options.quirks.empty() || options.quirks == "vip")) {
+        return runMachine<Chip8>(options, frontend);
+    } else if (options.model == "chip8" && options.quirks == "chip48") {
+        return runMachine<Chip48>(options, frontend);
+    } else if (options.model == "schip" && (options.quirks.empty() || options.quirks == "schip")) {
+        return runMachine<SuperChip8>(options, frontend);
+    } else if (options.model == "xochip" && (options.quirks.empty() || options.quirks == "xochip")) {
+        return runMachine<XOChip8>(options, frontend);
+    }
+    std::cerr << "Unsupported model/quirks " << options.model << "/" << options.quirks
+              << ", expected chip8 with vip or chip48, schip with schip, or xochip with xochip\n";
+    return 1;
+}
@@ -0,0 +1,170 @@
+#ifndef MOVIE_CPP
+#define MOVIE_CPP
+
+#include "movie.h"
+#include "chip8.cpp"
+
+// Input movies: everything needed to replay a session bit-for-bit.
+// Input only reaches the core between frames, so a movie is the CXNN seed, the frame length and
+// the keypad state every time it changed, keyed by the emulated frame counter. The footer holds the
+// last frame and its framebuffer hash so a replay can check itself.
+// All fields are little-endian:
+//   header  "CHIP8MV\0", u32 version, u32 seed, u32 cyclesPerFrame, u64 ROM hash, u64 start frame
+//   events  u64 frame, u16 keypad mask (bit n = key n), repeated
+//   footer  u64 0xFFFFFFFFFFFFFFFF, u64 end frame, u64 framebuffer hash
+
+constexpr uint32_t MOVIE_VERSION = 1;
+constexpr uint64_t MOVIE_END_MARKER = 0xFFFFFFFFFFFFFFFF;
+
+// FNV-1a of the loaded ROM, a movie only makes sense against the ROM it was recorded on
+template <typename Machine>
+inline uint64_t romHash(const Machine& chip8) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < chip8.romSize; i++) {
+        hash ^= chip8.memory[0x200 + i];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+class MovieRecorder {
+    public:
+        // Starts a movie from the current state of 'chip8', which must already be seeded
+        template <typename Machine>
+        bool open(const std::string& path, const Machine& chip8, uint32_t seed, uint32_t cyclesPerFrame) {
+            out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                std::cerr << "Problem writing movie " << path << "\n";
+                return false;
+            }
+            out.write("CHIP8MV", 8);
+            put(MOVIE_VERSION, 4);
+            put(seed, 4);
+            put(cyclesPerFrame, 4);
+            put(romHash(chip8), 8);
+            put(chip8.frameCount, 8);
+            lastMask = 0;
+            return out.good();
+        }
+
+        bool isOpen() const { return out.is_open(); }
+
+        // Call right before every frame, logs the keypad if it changed since the last frame
+        template <typename Machine>
+        void frame(const Machine& chip8) {
+            uint16_t mask = chip8.keypadMask();
+            if (mask != lastMask) {
+                put(chip8.frameCount, 8);
+                put(mask, 2);
+                lastMask = mask;
+            }
+        }
+
+        // Writes the footer, the replay has to reach this frame with the same display
+        template <typename Machine>
+        bool finish(const Machine& chip8) {
+            put(MOVIE_END_MARKER, 8);
+            put(chip8.frameCount, 8);
+            put(chip8.framebufferHash(), 8);
+            out.close();
+            return !out.fail();
+        }
+
+    private:
+        std::ofstream out;
+        uint16_t lastMask = 0;
+
+        void put(uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                out.put(static_cast<char>(value >> (8 * i)));
+            }
+        }
+};
+
+class MoviePlayer {
+    public:
+        uint32_t seed = 0;
+        uint32_t cyclesPerFrame = 0;
+        uint64_t expectedRomHash = 0;
+        uint64_t startFrame = 0;
+        uint64_t endFrame = 0;
+        uint64_t expectedFramebufferHash = 0;
+
+        // Reads the whole movie, returns false if it is unreadable or incomplete
+        bool open(const std::string& path) {
+            std::ifstream in(path, std::ios::in | std::ios::binary);
+            if (!in.is_open()) {
+                std::cerr << "Problem reading movie " << path << "\n";
+                return false;
+            }
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            size_t offset = 0;
+            auto get = [&](int bytes, uint64_t& value) {
+                if (offset + bytes > data.size()) return false;
+                value = 0;
+                for (int i = 0; i < bytes; i++) value |= (uint64_t)data[offset + i] << (8 * i);
+                offset += bytes;
+                return true;
+            };
+
+            uint64_t version, seedField, cyclesField;
+            if (data.size() < 8 || std::memcmp(data.data(), "CHIP8MV", 8) != 0) {
+                std::cerr << "Movie " << path << " is not a CHIP-8 movie\n";
+                return false;
+            }
+            offset = 8;
+            if (!get(4, version) || version != MOVIE_VERSION || !get(4, seedField) || !get(4, cyclesField)
+                || !get(8, expectedRomHash) || !get(8, startFrame)) {
+                std::cerr << "Movie " << path << " has an unsupported header\n";
+                return false;
+            }
+            seed = seedField;
+            cyclesPerFrame = cyclesField;
+
+            events.clear();
+            while (true) {
+                uint64_t frame, mask;
+                if (!get(8, frame)) {
+                    std::cerr << "Movie " << path << " is truncated\n";
+                    return false;
+                }
+                if (frame == MOVIE_END_MARKER) break;
+                if (!get(2, mask)) {
+                    std::cerr << "Movie " << path << " is truncated\n";
+                    return false;
+                }
+                events.push_back({frame, static_cast<uint16_t>(mask)});
+            }
+            if (!get(8, endFrame) || !get(8, expectedFramebufferHash)) {
+                std::cerr << "Movie " << path << " is truncated\n";
+                return false;
+            }
+            nextEvent = 0;
+            return true;
+        }
+
+        // Call right before every frame, sets the keypad exactly as it was when recording
+        template <typename Machine>
+        void frame(Machine& chip8) {
+            while (nextEvent < events.size() && events[nextEvent].frame <= chip8.frameCount) {
+                chip8.setKeypadMask(events[nextEvent].mask);
+                nextEvent++;
+            }
+        }
+
+        template <typename Machine>
+        bool finished(const Machine& chip8) const {
+            return chip8.frameCount >= endFrame;
+        }
+
+    private:
+        struct Event {
+            uint64_t frame;
+            uint16_t mask;
+        };
+        std::vector<Event> events;
+        size_t nextEvent = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef PIPELINE_CPP
+#define PIPELINE_CPP
+
+#include "pipeline.h"
+
+// Lock-free hand-off between the emulation thread and the SDL thread: finished frames go one way
+// through a triple buffer, keypad changes the other way through a single-producer single-consumer
+// queue. Neither side ever blocks on the other
+
+// What the emulation thread publishes after a frame that changed the display
+struct VideoFrame {
+    uint64_t rows[128 / 64 * 64 * 4];   // Chip8::gfx, large enough for the 128x64 4-plane XO-CHIP display
+    uint64_t frame;         // Chip8::frameCount when it was published
+    int width = 64;         // Display size and planes of the machine that published it
+    int height = 32;
+    int planes = 1;
+};
+
+// Keyboard state as the SDL thread last saw it
+struct InputState {
+    uint16_t keypad = 0;    // bit n is key n
+    bool rewindHeld = false;
+
+    bool operator!=(const InputState& other) const {
+        return keypad != other.keypad || rewindHeld != other.rewindHeld;
+    }
+};
+
+// One writer, one reader, the reader always gets the newest complete value. The writer fills its
+// private slot and swaps it with the shared middle one, the reader swaps the middle one with its own
+// when it is marked fresh, so a slow reader just skips values and a slow writer is never waited on
+template <typename T>
+class TripleBuffer {
+    public:
+        // Writer side: fill this, then publish()
+        T& writeSlot() {
+            return slots[back].value;
+        }
+
+        void publish() {
+            back = shared.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Reader side: returns true and moves readSlot() to the newest value if one was published since
+        bool consume() {
+            if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+            front = shared.exchange(front, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        const T& readSlot() const {
+            return slots[front].value;
+        }
+
+    private:
+        static constexpr uint8_t INDEX = 3;
+        static constexpr uint8_t FRESH = 4;
+
+        struct alignas(64) Slot {
+            T value{};
+        };
+        Slot slots[3];
+        alignas(64) std::atomic<uint8_t> shared{1};     // index of the middle slot, plus FRESH
+        alignas(64) uint8_t back = 0;                   // writer's slot
+        alignas(64) uint8_t front = 2;                  // reader's slot
+};
+
+// Bounded single-producer single-consumer ring, 'Capacity' must be a power of two
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Producer side, returns false if the queue is full
+        bool push(const T& item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            items[t & (Capacity - 1)] = item;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side, returns false if the queue is empty
+        bool pop(T& item) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[h & (Capacity - 1)];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side
+        bool empty() const {
+            return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        T items[Capacity];
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
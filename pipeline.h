@@ -0,0 +1,3 @@
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
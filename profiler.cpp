@@ -0,0 +1,130 @@
+#ifndef PROFILER_CPP
+#define PROFILER_CPP
+
+#include "profiler.h"
+
+// Execution profile of the interpreter, only compiled in with -DCHIP8_PROFILE ('make profile').
+// Counts executions per opcode class and per address, follows 2NNN/00EE to attribute every
+// instruction to its subroutine call stack and counts Fx0A busy-wait iterations. The stacks are
+// written in the collapsed "frame;frame;frame count" format flamegraph.pl and speedscope read.
+// Hooks report to the profile installed for the current thread in 'activeProfile'
+class Chip8Profile {
+    public:
+        uint64_t opCounts[OP_COUNT] = {0};
+        std::vector<uint64_t> addressCounts;    // one per byte of the machine's memory, 64KB on XO-CHIP
+        uint64_t calls = 0;
+        uint64_t returns = 0;
+        uint64_t keyWaitSpins = 0;
+        uint64_t idleSkipped = 0;
+        int depth = 0;
+        int maxDepth = 0;
+
+        explicit Chip8Profile(uint32_t memorySize = 4096) : addressCounts(memorySize, 0) {
+            nodes.push_back(Node{0, 0, 0});     // root, code outside any subroutine
+        }
+
+        void instruction(uint16_t address, uint8_t opClass) {
+            opCounts[opClass]++;
+            addressCounts[address & (addressCounts.size() - 1)]++;
+            nodes[currentNode].samples++;
+        }
+
+        void call(uint16_t target) {
+            calls++;
+            depth++;
+            maxDepth = std::max(maxDepth, depth);
+
+            uint64_t key = (uint64_t)currentNode << 16 | target;
+            auto found = children.find(key);
+            if (found == children.end()) {
+                nodes.push_back(Node{currentNode, target, 0});
+                found = children.emplace(key, nodes.size() - 1).first;
+            }
+            currentNode = found->second;
+        }
+
+        void ret() {
+            returns++;
+            if (depth > 0) {
+                depth--;
+                currentNode = nodes[currentNode].parent;
+            }
+        }
+
+        void keyWaitSpin(uint64_t spins) {
+            keyWaitSpins += spins;
+        }
+
+        // Instructions fast-forwarded by idle loop detection, never executed so not in the other counts
+        void idle(uint64_t instructions) {
+            idleSkipped += instructions;
+        }
+
+        // Human readable summary, 'memory' (of the size given to the constructor) is used to show the opcode at each hot address
+        void writeReport(std::ostream& out, const uint8_t* memory, int hotAddresses = 20) const {
+            uint64_t total = 0;
+            for (uint64_t count : opCounts) total += count;
+
+            out << "Instructions executed: " << total << "\n";
+            out << "Subroutine calls: " << calls << ", returns: " << returns << ", max call depth: " << maxDepth << "\n";
+            out << "Fx0A wait iterations: " << keyWaitSpins << "\n";
+            out << "Idle instructions skipped: " << idleSkipped << "\n\n";
+
+            std::vector<int> classes;
+            for (int opClass = 0; opClass < OP_COUNT; opClass++) {
+                if (opCounts[opClass]) classes.push_back(opClass);
+            }
+            std::sort(classes.begin(), classes.end(), [this](int a, int b) { return opCounts[a] > opCounts[b]; });
+
+            out << "Opcode class        count        %\n";
+            for (int opClass : classes) {
+                out << std::left << std::setw(12) << opClassNames[opClass] << std::right << std::setw(13) << opCounts[opClass]
+                    << std::setw(9) << std::fixed << std::setprecision(2) << 100.0 * opCounts[opClass] / std::max<uint64_t>(total, 1) << "\n";
+            }
+
+            std::vector<int> addresses;
+            const int memorySize = addressCounts.size();
+            for (int address = 0; address < memorySize; address++) {
+                if (addressCounts[address]) addresses.push_back(address);
+            }
+            std::sort(addresses.begin(), addresses.end(), [this](int a, int b) { return addressCounts[a] > addressCounts[b]; });
+            if ((int)addresses.size() > hotAddresses) addresses.resize(hotAddresses);
+
+            out << "\nAddress  opcode        count        %\n";
+            for (int address : addresses) {
+                uint16_t opcode = (memory[address] << 8) | memory[(address + 1) & (memorySize - 1)];
+                out << "0x" << std::hex << std::setw(memorySize > 4096 ? 4 : 3) << std::setfill('0') << address << "    " << std::setw(4) << opcode
+                    << std::dec << std::setfill(' ') << std::setw(13) << addressCounts[address]
+                    << std::setw(9) << std::setprecision(2) << 100.0 * addressCounts[address] / std::max<uint64_t>(total, 1) << "\n";
+            }
+        }
+
+        // One "main;sub_XXX;sub_YYY count" line per call stack that executed anything
+        void writeCollapsed(std::ostream& out) const {
+            for (size_t node = 0; node < nodes.size(); node++) {
+                if (nodes[node].samples == 0) continue;
+                out << stackName(node) << " " << nodes[node].samples << "\n";
+            }
+        }
+
+    private:
+        struct Node {
+            uint32_t parent;
+            uint16_t address;
+            uint64_t samples;
+        };
+        std::vector<Node> nodes;
+        std::unordered_map<uint64_t, uint32_t> children;    // (parent << 16 | target) -> node
+        uint32_t currentNode = 0;
+
+        std::string stackName(uint32_t node) const {
+            if (node == 0) return "main";
+            std::ostringstream name;
+            name << stackName(nodes[node].parent) << ";sub_0x" << std::hex << std::setw(3) << std::setfill('0') << nodes[node].address;
+            return name.str();
+        }
+};
+
+inline thread_local Chip8Profile* activeProfile = nullptr;
+
+#endif
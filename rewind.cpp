@@ -0,0 +1,178 @@
+#ifndef REWIND_CPP
+#define REWIND_CPP
+
+#include "rewind.h"
+#include "chip8.cpp"
+
+// Bounded in-memory history of per-frame states for stepping backwards.
+// Only the newest state is kept whole, every older frame is stored as the XOR of two consecutive
+// raw machine images, run-length encoded as (zero bytes to skip, literal length, literal bytes) runs.
+// Between frames only a few registers, counters, gfx rows and memory bytes change, so an entry is
+// usually tens of bytes. Stepping back XORs the newest delta into the current state, which costs the
+// same however long the history is. Deltas live in one circular byte buffer and the oldest frames
+// are dropped when it is full
+template <typename Machine>
+class BasicRewindBuffer {
+    public:
+        explicit BasicRewindBuffer(size_t capacityBytes = 4 << 20) : ring(capacityBytes) {}
+
+        // Frames that can currently be stepped back
+        size_t size() const { return entries.size(); }
+
+        size_t bytesUsed() const { return used; }
+
+        void clear() {
+            entries.clear();
+            hasLatest = false;
+            head = 0;
+            used = 0;
+        }
+
+        // Records the state at the end of a frame
+        void record(const Machine& state) {
+            const uint8_t* current = reinterpret_cast<const uint8_t*>(&state);
+            if (!hasLatest) {
+                std::memcpy(latest, current, sizeof(Machine));
+                hasLatest = true;
+                return;
+            }
+
+            encodeDelta(latest, current);
+            std::memcpy(latest, current, sizeof(Machine));
+            if (scratch.size() > ring.size()) {
+                clear();     // a single delta bigger than the whole buffer, start over from here
+                record(state);
+                return;
+            }
+            store(scratch.data(), scratch.size());
+        }
+
+        // Replaces 'state' with the frame before the last recorded one, returns false once history runs out
+        bool stepBack(Machine& state) {
+            if (entries.empty()) {
+                return false;
+            }
+
+            Entry entry = entries.back();
+            entries.pop_back();
+            used -= entry.size;
+            head = entry.offset;
+            applyDelta(&ring[entry.offset], entry.size, latest);
+
+            std::memcpy(static_cast<void*>(&state), latest, sizeof(Machine));
+            state.dirtyRows = Machine::Display::ALL_ROWS;
+            return true;
+        }
+
+    private:
+        struct Entry {
+            size_t offset;
+            size_t size;
+        };
+
+        std::vector<uint8_t> ring;
+        std::deque<Entry> entries;  // oldest first
+        size_t head = 0;            // where the next delta goes
+        size_t used = 0;
+        alignas(Machine) uint8_t latest[sizeof(Machine)];
+        bool hasLatest = false;
+        std::vector<uint8_t> scratch;
+
+        void put16(uint16_t value) {
+            scratch.push_back(value & 0xFF);
+            scratch.push_back(value >> 8);
+        }
+
+        // Runs longer than 16 bits allow (only possible with the 64KB XO-CHIP memory) are split
+        void putRun(size_t skip, const uint8_t* from, const uint8_t* to, size_t literalStart, size_t literalEnd) {
+            for (; skip > 0xFFFF; skip -= 0xFFFF) {
+                put16(0xFFFF);
+                put16(0);
+            }
+            do {
+                size_t length = std::min<size_t>(literalEnd - literalStart, 0xFFFF);
+                put16(skip);
+                put16(length);
+                for (size_t i = literalStart; i < literalStart + length; i++) {
+                    scratch.push_back(from[i] ^ to[i]);
+                }
+                literalStart += length;
+                skip = 0;
+            } while (literalStart < literalEnd);
+        }
+
+        // XOR of 'from' and 'to' as runs of (uint16 skip, uint16 length, length bytes)
+        void encodeDelta(const uint8_t* from, const uint8_t* to) {
+            scratch.clear();
+            size_t position = 0;
+            size_t runStart = 0;
+            while (position < sizeof(Machine)) {
+                // skip equal bytes a word at a time
+                while (position + 8 <= sizeof(Machine)) {
+                    uint64_t a, b;
+                    std::memcpy(&a, from + position, 8);
+                    std::memcpy(&b, to + position, 8);
+                    if (a != b) break;
+                    position += 8;
+                }
+                while (position < sizeof(Machine) && from[position] == to[position]) position++;
+                if (position == sizeof(Machine)) break;
+
+                size_t literalStart = position;
+                // a literal run ends at the first 4 equal bytes in a row
+                size_t equalRun = 0;
+                while (position < sizeof(Machine) && equalRun < 4) {
+                    equalRun = from[position] == to[position] ? equalRun + 1 : 0;
+                    position++;
+                }
+                size_t literalEnd = position - equalRun;
+
+                putRun(literalStart - runStart, from, to, literalStart, literalEnd);
+                runStart = literalEnd;
+                position = literalEnd;
+            }
+        }
+
+        static void applyDelta(const uint8_t* delta, size_t size, uint8_t* state) {
+            size_t position = 0;
+            size_t offset = 0;
+            while (offset < size) {
+                uint16_t skip = delta[offset] | (delta[offset + 1] << 8);
+                uint16_t length = delta[offset + 2] | (delta[offset + 3] << 8);
+                offset += 4;
+                position += skip;
+                for (uint16_t i = 0; i < length; i++) {
+                    state[position + i] ^= delta[offset + i];
+                }
+                position += length;
+                offset += length;
+            }
+        }
+
+        void store(const uint8_t* delta, size_t size) {
+            if (head + size > ring.size()) {
+                // the tail of the buffer is too short, everything still stored there is the oldest history
+                while (!entries.empty() && entries.front().offset >= head) {
+                    evictOldest();
+                }
+                head = 0;
+            }
+            while (!entries.empty() && entries.front().offset < head + size && entries.front().offset + entries.front().size > head) {
+                evictOldest();
+            }
+
+            std::memcpy(&ring[head], delta, size);
+            entries.push_back({head, size});
+            head += size;
+            used += size;
+        }
+
+        void evictOldest() {
+            used -= entries.front().size;
+            entries.pop_front();
+        }
+};
+
+using RewindBuffer = BasicRewindBuffer<Chip8>;
+
+#endif
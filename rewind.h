@@ -0,0 +1,5 @@
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <vector>
@@ -0,0 +1,81 @@
+#ifndef ROMCACHE_CPP
+#define ROMCACHE_CPP
+
+#include "romcache.h"
+#include "chip8.cpp"
+#include "movie.cpp"
+
+// Boot images for batch runs: every ROM file is mapped, checked and baked into a booted machine
+// (fontset, ROM at 0x200 and the decode cache built for both) exactly once, so starting an instance
+// is a copy of that image instead of opening the file and decoding all of memory again.
+// Images are keyed by ROM content, paths to identical ROMs share one. Fill the cache before starting
+// any workers, lookups are read-only and safe from any thread afterwards
+
+class RomCache {
+    public:
+        // Maps 'path' and bakes its image unless that was done already, returns false (and says why)
+        // if it can't be read or doesn't fit. Same checks and messages as Chip8::loadROM()
+        bool add(const std::string& path) {
+            if (byPath.count(path)) {
+                return byPath[path] != nullptr;
+            }
+            byPath[path] = nullptr;     // a failure is remembered too, and reported once
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0) {
+                std::cerr << "Problem reading file " << path << "\n";
+                if (fd >= 0) ::close(fd);
+                return false;
+            }
+            if (info.st_size <= 0 || (size_t)info.st_size > Chip8::MAX_ROM_SIZE) {
+                std::cerr << "ROM too big or empty " << path << "\n";
+                ::close(fd);
+                return false;
+            }
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                std::cerr << "Problem reading file " << path << "\n";
+                return false;
+            }
+
+            std::unique_ptr<Chip8> image(new Chip8());
+            image->loadFontset();
+            image->loadROM(static_cast<const uint8_t*>(mapping), info.st_size);
+            munmap(mapping, info.st_size);
+
+            // The key is the hash movies record, a match still has to compare equal
+            uint64_t hash = romHash(*image);
+            auto same = byContent.equal_range(hash);
+            for (auto it = same.first; it != same.second; ++it) {
+                const Chip8& other = *it->second;
+                if (other.romSize == image->romSize
+                    && std::equal(other.memory + 0x200, other.memory + 0x200 + other.romSize, image->memory + 0x200)) {
+                    byPath[path] = &other;
+                    return true;
+                }
+            }
+            byPath[path] = image.get();
+            byContent.emplace(hash, image.get());
+            images.push_back(std::move(image));
+            return true;
+        }
+
+        // Booted machine for an added path, nullptr if it failed to load. Start an instance with
+        // 'Chip8 chip8 = *image;' and seed it
+        const Chip8* find(const std::string& path) const {
+            auto it = byPath.find(path);
+            return it == byPath.end() ? nullptr : it->second;
+        }
+
+        // Distinct ROMs baked so far
+        size_t size() const { return images.size(); }
+
+    private:
+        std::vector<std::unique_ptr<Chip8>> images;
+        std::unordered_map<std::string, const Chip8*> byPath;
+        std::unordered_multimap<uint64_t, const Chip8*> byContent;
+};
+
+#endif
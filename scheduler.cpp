@@ -0,0 +1,90 @@
+#ifndef SCHEDULER_CPP
+#define SCHEDULER_CPP
+
+#include "scheduler.h"
+
+// Paces the main loop on an absolute timeline: frame n is due at origin + n * interval, so sleep
+// jitter and slow iterations never accumulate into drift. A host that fell behind runs frames back
+// to back until it is on time again; more than 'maxLag' behind (a stall, a debugger) the timeline
+// restarts from now instead of fast-forwarding through everything that was missed
+class FrameScheduler {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        explicit FrameScheduler(double hz = 60.0, clock::duration maxLag = std::chrono::milliseconds(250))
+            : hz(hz), maxLag(maxLag) {
+            reset();
+        }
+
+        uint64_t resyncs = 0;   // times the host was so far behind that frames were dropped
+
+        // Restarts the timeline, the next frame is due right away
+        void reset() {
+            origin = clock::now();
+            frames = 0;
+        }
+
+        // When the next frame is due
+        clock::time_point deadline() const {
+            return origin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(frames / hz));
+        }
+
+        // Marks one frame as emulated, returns true if the next one is already due (catching up)
+        bool frameDone() {
+            frames++;
+            auto now = clock::now();
+            if (now - deadline() > maxLag) {
+                resyncs++;
+                origin = now;
+                frames = 0;
+                return false;
+            }
+            return now >= deadline();
+        }
+
+        // Sleeps until the next frame is due. Most of the wait goes to 'waitEvents(ms)' if given, which
+        // should block until an event arrives or the timeout passes and return false to stop the loop,
+        // the last millisecond is slept precisely. Returns false if 'waitEvents' did
+        bool sleepUntilDue(const std::function<bool(int)>& waitEvents = nullptr) {
+            while (true) {
+                auto remaining = deadline() - clock::now();
+                if (remaining <= clock::duration::zero()) {
+                    return true;
+                }
+
+                int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+                if (waitEvents && milliseconds >= 2) {
+                    if (!waitEvents(milliseconds - 1)) return false;
+                    continue;
+                }
+
+                sleepUntil(deadline());
+                return true;
+            }
+        }
+
+    private:
+        double hz;
+        clock::duration maxLag;
+        clock::time_point origin;
+        uint64_t frames = 0;
+
+        // steady_clock is CLOCK_MONOTONIC on Linux, an absolute sleep there can't overshoot by a scheduling slice twice
+        static void sleepUntil(clock::time_point when) {
+#ifdef __linux__
+            auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+            timespec target{static_cast<time_t>(sinceEpoch / 1000000000), static_cast<long>(sinceEpoch % 1000000000)};
+            int error;
+            while ((error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, nullptr)) == EINTR) {
+                // interrupted by a signal, the deadline is still the same
+            }
+            if (error != 0) {
+                std::this_thread::sleep_until(when);    // EINVAL/ENOTSUP, retrying would only spin
+            }
+#else
+            std::this_thread::sleep_until(when);
+#endif
+        }
+};
+
+#endif
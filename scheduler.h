@@ -0,0 +1,6 @@
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <time.h>
+#include <cerrno>
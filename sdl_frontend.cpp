@@ -0,0 +1,259 @@
+#ifndef SDL_FRONTEND_CPP
+#define SDL_FRONTEND_CPP
+
+#include "sdl_frontend.h"
+#include "chip8.cpp"
+#include "framebuffer.cpp"
+
+// Optional SDL consumer of the headless Chip8 core: owns the window, renderer and
+// texture, turns SDL keyboard events into keypad state and presents changed gfx rows once per vblank.
+// Everything but wake() must be called from the thread that initialized SDL
+class SDLFrontend {
+    public:
+        // SDL-specific members
+        SDL_Window* window = nullptr;
+        SDL_Renderer* renderer = nullptr;
+        SDL_Texture* texture = nullptr;
+        uint32_t pixels[128 * 64] = {0};      // RGBA pixel buffer for rendering, 'width' pixels per row
+        uint64_t presentedRows[128 / 64 * 64 * 4] = {0}; // gfx words as they were last uploaded to the texture
+        int width = 64;                       // Display mode of the texture, see setMode()
+        int height = 32;
+        int planes = 1;
+        bool stale = true;                    // the texture is new or was recreated, the next present uploads everything
+        
+        // Constants for rendering
+        const int PIXEL_SIZE = 10;            // Size of each CHIP-8 pixel
+        Palette palette;                      // ON/OFF pixel colours, white on black by default
+        bool rewindHeld = false;              // Backspace is down
+        uint16_t keyMask = 0;                 // Keypad keys held down, bit n is key n
+        uint32_t wakeEvent = 0;               // SDL user event type posted by wake()
+        std::atomic<bool> wakePending{false}; // wake() was called and frameHandled() not since
+
+        // Initialize SDL systems
+        bool initializeSDL() {
+            if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
+                std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+            
+            window = SDL_CreateWindow("CHIP-8 Emulator", 
+                                      SDL_WINDOWPOS_CENTERED, 
+                                      SDL_WINDOWPOS_CENTERED,
+                                      64 * PIXEL_SIZE, 
+                                      32 * PIXEL_SIZE, 
+                                      SDL_WINDOW_SHOWN);
+            if (!window) {
+                std::cerr << "Window creation failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+            
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+            if (!renderer) {
+                std::cerr << "Renderer creation failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+            
+            texture = SDL_CreateTexture(renderer, 
+                                        SDL_PIXELFORMAT_RGBA8888, 
+                                        SDL_TEXTUREACCESS_STREAMING, 
+                                        64, 32);
+            if (!texture) {
+                std::cerr << "Texture creation failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+            
+            wakeEvent = SDL_RegisterEvents(1);
+
+            // Initialize pixels to the OFF colour
+            for (int i = 0; i < 64 * 32; i++) {
+                pixels[i] = palette.off;
+            }
+            
+            return true;
+        }
+
+        // Switches the texture to a 'w' x 'h' display with 'p' bitplanes (SUPER-CHIP and XO-CHIP are 128x64),
+        // the window keeps its size and the texture is scaled to fill it
+        bool setMode(int w, int h, int p) {
+            if (w == width && h == height && p == planes) {
+                return true;
+            }
+            SDL_Texture* resized = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+            if (!resized) {
+                std::cerr << "Texture creation failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+            SDL_DestroyTexture(texture);
+            texture = resized;
+            width = w;
+            height = h;
+            planes = p;
+            stale = true;
+            return true;
+        }
+        
+        // Cleanup SDL resources
+        void cleanupSDL() {
+            if (texture) {
+                SDL_DestroyTexture(texture);
+                texture = nullptr;
+            }
+            if (renderer) {
+                SDL_DestroyRenderer(renderer);
+                renderer = nullptr;
+            }
+            if (window) {
+                SDL_DestroyWindow(window);
+                window = nullptr;
+            }
+            SDL_Quit();
+        }
+        
+        // Handle SDL events and input, returns false once the user asked to quit.
+        // Updates 'keyMask' and 'rewindHeld', the emulation side picks them up between frames
+        bool pollInput() {
+            uint8_t keypad[16];
+            for (int key = 0; key < 16; key++) {
+                keypad[key] = (keyMask >> key) & 1;
+            }
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                if (event.type == SDL_QUIT) {
+                    return false;
+                } else if (event.type == wakeEvent) {
+                    // nothing to do, it only ended waitForEvents()
+                } else if (event.type == SDL_KEYDOWN) {
+
+                    // Map keyboard keys to CHIP-8 keypad according to requested layout:
+                    // Keyboard:   CHIP-8 hex value mapping:
+                    // 1 2 3 4     1 2 3 C
+                    // q w e r     4 5 6 D
+                    // a s d f     7 8 9 E
+                    // z x c v     A 0 B F
+                    switch (event.key.keysym.sym) {
+                        case SDLK_1: keypad[0x1] = 1; break; // 1
+                        case SDLK_2: keypad[0x2] = 1; break; // 2
+                        case SDLK_3: keypad[0x3] = 1; break; // 3
+                        case SDLK_4: keypad[0xC] = 1; break; // C
+                        
+                        case SDLK_q: keypad[0x4] = 1; break; // 4
+                        case SDLK_w: keypad[0x5] = 1; break; // 5
+                        case SDLK_e: keypad[0x6] = 1; break; // 6
+                        case SDLK_r: keypad[0xD] = 1; break; // D
+                        
+                        case SDLK_a: keypad[0x7] = 1; break; // 7
+                        case SDLK_s: keypad[0x8] = 1; break; // 8
+                        case SDLK_d: keypad[0x9] = 1; break; // 9
+                        case SDLK_f: keypad[0xE] = 1; break; // E
+                        
+                        case SDLK_z: keypad[0xA] = 1; break; // A
+                        case SDLK_x: keypad[0x0] = 1; break; // 0
+                        case SDLK_c: keypad[0xB] = 1; break; // B
+                        case SDLK_v: keypad[0xF] = 1; break; // F
+                        
+                        case SDLK_BACKSPACE: rewindHeld = true; break;
+
+                        case SDLK_ESCAPE: return false;      // ESC to quit
+                    }
+                } else if (event.type == SDL_KEYUP) {
+                    switch (event.key.keysym.sym) {
+                        case SDLK_1: keypad[0x1] = 0; break;
+                        case SDLK_2: keypad[0x2] = 0; break;
+                        case SDLK_3: keypad[0x3] = 0; break;
+                        case SDLK_4: keypad[0xC] = 0; break;
+                        
+                        case SDLK_q: keypad[0x4] = 0; break;
+                        case SDLK_w: keypad[0x5] = 0; break;
+                        case SDLK_e: keypad[0x6] = 0; break;
+                        case SDLK_r: keypad[0xD] = 0; break;
+                        
+                        case SDLK_a: keypad[0x7] = 0; break;
+                        case SDLK_s: keypad[0x8] = 0; break;
+                        case SDLK_d: keypad[0x9] = 0; break;
+                        case SDLK_f: keypad[0xE] = 0; break;
+                        
+                        case SDLK_z: keypad[0xA] = 0; break;
+                        case SDLK_x: keypad[0x0] = 0; break;
+                        case SDLK_c: keypad[0xB] = 0; break;
+                        case SDLK_v: keypad[0xF] = 0; break;
+
+                        case SDLK_BACKSPACE: rewindHeld = false; break;
+                    }
+                }
+            }
+
+            keyMask = 0;
+            for (int key = 0; key < 16; key++) {
+                keyMask |= keypad[key] << key;
+            }
+            return true;
+        }
+
+        // Blocks until an event arrives (input or a wake()) or 'timeoutMs' passes, pollInput() handles it
+        void waitForEvents(int timeoutMs) {
+            SDL_WaitEventTimeout(nullptr, timeoutMs);
+        }
+
+        // Interrupts waitForEvents(), safe from any thread. Wakes again only after frameHandled(),
+        // so a producer much faster than the display doesn't flood the event queue
+        void wake() {
+            if (!wakePending.exchange(true, std::memory_order_acq_rel)) {
+                SDL_Event event = {};
+                event.type = wakeEvent;
+                SDL_PushEvent(&event);
+            }
+        }
+
+        void frameHandled() {
+            wakePending.store(false, std::memory_order_release);
+        }
+
+        // Uploads the rows of 'gfx' marked in 'dirty' that differ from what is on screen and presents once.
+        // Meant to be called at most once per 60Hz vblank, however many sprites were drawn in between
+        // 'gfx' is laid out as in DisplayEngine for the current setMode()
+        void present(const uint64_t* gfx, uint64_t dirty) {
+            const int rowWords = width / 64;
+            const int planeWords = rowWords * height;
+            if (height < 64) {
+                dirty &= (uint64_t(1) << height) - 1;
+            }
+
+            // Rows drawn and erased again within the frame are identical to what's on screen already
+            for (int y = 0; y < height && !stale; y++) {
+                bool same = dirty >> y & 1;
+                for (int p = 0; p < planes && same; p++) {
+                    const int first = p * planeWords + y * rowWords;
+                    same = std::equal(gfx + first, gfx + first + rowWords, presentedRows + first);
+                }
+                if (same) {
+                    dirty &= ~(uint64_t(1) << y);
+                }
+            }
+            stale = false;
+            if (dirty == 0) {
+                return;
+            }
+
+            int firstRow = __builtin_ctzll(dirty);
+            int lastRow = 63 - __builtin_clzll(dirty);
+
+            // Update pixel buffer from the packed gfx rows, a 128 pixel row is two consecutive 64 pixel words
+            if (planes == 1) {
+                expandFramebuffer(gfx, firstRow * rowWords, (lastRow + 1) * rowWords - 1, pixels, 64, palette);
+            } else {
+                expandPlanes(gfx, width, height, planes, firstRow, lastRow, pixels, palette);
+            }
+            std::copy(gfx, gfx + planeWords * planes, presentedRows);
+            
+            // Update only the changed band of the texture
+            SDL_Rect rows = {0, firstRow, width, lastRow - firstRow + 1};
+            SDL_UpdateTexture(texture, &rows, &pixels[firstRow * width], width * sizeof(uint32_t));
+            
+            // Clear renderer and render the texture
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+        }
+};
+
+#endif
@@ -0,0 +1,4 @@
+#include <cstdint>
+#include <iostream>
+#include <atomic>
+#include <SDL2/SDL.h>
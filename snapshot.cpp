@@ -0,0 +1,222 @@
+#ifndef SNAPSHOT_CPP
+#define SNAPSHOT_CPP
+
+#include "snapshot.h"
+#include "chip8.cpp"
+
+// Save states. Chip8 is trivially copyable, so a snapshot is the raw object image up to the decode
+// cache: a 64-byte header followed by 'count' Chip8 images, each padded to a 64-byte stride. The cache
+// is derived from memory and would be most of every state, so it is left out and rebuilt on restore.
+// Restoring is one memcpy straight out of a read-only memory mapping plus that re-decode, no per-field
+// parsing. The header records the object size and a hash of the member layout, so a file written by a
+// build with a different layout is refused rather than misread, and the few fields used as indices
+// (pc, sp, the stack, romSize) are range checked when the file is opened. Anything holding derived
+// state (e.g. a Chip8JIT) has to be flushed after a restore
+
+constexpr uint32_t SNAPSHOT_VERSION = 4;     // 2: quirk profiles, CHIP-8 snapshots are taken under the vip profile
+                                             // 3: the decode cache is no longer stored
+                                             // 4: stackFault, in what used to be padding
+
+// Bytes of a Chip8 a snapshot stores, everything before the decode cache
+constexpr size_t snapshotStateBytes() {
+    return offsetof(Chip8, decodeCache);
+}
+
+// Only alignment padding may follow the cache
+static_assert(sizeof(Chip8) - (offsetof(Chip8, decodeCache) + sizeof(Chip8::decodeCache)) < alignof(Chip8),
+              "the decode cache must stay the last member, snapshots stop right before it");
+
+struct SnapshotHeader {
+    char magic[8];          // "CHIP8SS\0"
+    uint32_t version;
+    uint32_t stateSize;     // snapshotStateBytes() of the writer
+    uint32_t stride;        // bytes between consecutive states
+    uint32_t count;         // number of states in the file
+    uint64_t layoutHash;    // snapshotLayoutHash() of the writer
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+constexpr uint32_t snapshotStride() {
+    return (snapshotStateBytes() + 63) / 64 * 64;
+}
+
+// Changes whenever a field moves or changes size
+constexpr uint64_t snapshotLayoutHash() {
+    const uint64_t fields[] = {
+        sizeof(Chip8),
+        offsetof(Chip8, memory), offsetof(Chip8, registers), offsetof(Chip8, delay_timer), offsetof(Chip8, sound_timer),
+        offsetof(Chip8, I), offsetof(Chip8, pc), offsetof(Chip8, romSize), offsetof(Chip8, sp), offsetof(Chip8, stack),
+        offsetof(Chip8, keypad), offsetof(Chip8, pressedKey), offsetof(Chip8, gfx), offsetof(Chip8, dirtyRows),
+        offsetof(Chip8, stackFault),
+        offsetof(Chip8, cycleCount), offsetof(Chip8, frameCount), offsetof(Chip8, decodeCache), offsetof(Chip8, randomState),
+    };
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint64_t field : fields) {
+        hash ^= field;
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+inline SnapshotHeader makeSnapshotHeader(uint32_t count) {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, "CHIP8SS", 8);
+    header.version = SNAPSHOT_VERSION;
+    header.stateSize = snapshotStateBytes();
+    header.stride = snapshotStride();
+    header.count = count;
+    header.layoutHash = snapshotLayoutHash();
+    return header;
+}
+
+// Writes 'count' states to one file, returns false on I/O errors
+inline bool saveSnapshots(const std::string& path, const Chip8* states, uint32_t count) {
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Problem writing snapshot " << path << "\n";
+        return false;
+    }
+
+    SnapshotHeader header = makeSnapshotHeader(count);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const char padding[64] = {0};
+    for (uint32_t i = 0; i < count; i++) {
+        out.write(reinterpret_cast<const char*>(&states[i]), snapshotStateBytes());
+        out.write(padding, snapshotStride() - snapshotStateBytes());
+    }
+    return out.good();
+}
+
+inline bool saveSnapshot(const std::string& path, const Chip8& state) {
+    return saveSnapshots(path, &state, 1);
+}
+
+// Read-only memory mapping of a snapshot file, the states are never copied until restored
+class MappedSnapshots {
+    public:
+        MappedSnapshots() = default;
+        MappedSnapshots(const MappedSnapshots&) = delete;
+        MappedSnapshots& operator=(const MappedSnapshots&) = delete;
+
+        ~MappedSnapshots() {
+            close();
+        }
+
+        // Maps and validates the file, returns false if it is missing, truncated, from another layout or
+        // holds a state whose pc, stack or ROM size is out of range
+        bool open(const std::string& path) {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                std::cerr << "Problem reading snapshot " << path << "\n";
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader)) {
+                std::cerr << "Snapshot " << path << " is truncated\n";
+                ::close(fd);
+                return false;
+            }
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                std::cerr << "Problem mapping snapshot " << path << "\n";
+                return false;
+            }
+            data = static_cast<const uint8_t*>(mapping);
+            mappedSize = info.st_size;
+
+            SnapshotHeader expected = makeSnapshotHeader(0);
+            const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(data);
+            if (std::memcmp(header->magic, expected.magic, 8) != 0 || header->version != expected.version
+                || header->stateSize != expected.stateSize || header->stride != expected.stride
+                || header->layoutHash != expected.layoutHash) {
+                std::cerr << "Snapshot " << path << " was written by an incompatible build\n";
+                close();
+                return false;
+            }
+            if (sizeof(SnapshotHeader) + (size_t)header->count * header->stride > mappedSize) {
+                std::cerr << "Snapshot " << path << " is truncated\n";
+                close();
+                return false;
+            }
+            for (uint32_t i = 0; i < header->count; i++) {
+                if (!plausibleState(stateData(i))) {
+                    std::cerr << "Snapshot " << path << " is corrupt, state " << i << " is out of range\n";
+                    close();
+                    return false;
+                }
+            }
+            stateCount = header->count;
+            return true;
+        }
+
+        void close() {
+            if (data) {
+                munmap(const_cast<uint8_t*>(data), mappedSize);
+            }
+            data = nullptr;
+            mappedSize = 0;
+            stateCount = 0;
+        }
+
+        uint32_t size() const { return stateCount; }
+
+        // Copies state 'index' into 'chip8' with a single memcpy and rebuilds its decode cache
+        void restore(uint32_t index, Chip8& chip8) const {
+            std::memcpy(static_cast<void*>(&chip8), stateData(index), snapshotStateBytes());
+            chip8.invalidateDecodeCache();
+            chip8.dirtyRows = 0xFFFFFFFF;    // whatever was on screen before is stale
+        }
+
+        // Forks 'count' instances from state 'index'
+        void restoreMany(uint32_t index, Chip8* instances, size_t count) const {
+            for (size_t i = 0; i < count; i++) {
+                restore(index, instances[i]);
+            }
+        }
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t mappedSize = 0;
+        uint32_t stateCount = 0;
+
+        const uint8_t* stateData(uint32_t index) const {
+            return data + sizeof(SnapshotHeader) + (size_t)index * snapshotStride();
+        }
+
+        // The fields the interpreter indexes with unchecked: 00EE reads stack[sp], the fetch reads
+        // memory[pc] and hasMoreOpcodes() compares against romSize
+        static bool plausibleState(const uint8_t* state) {
+            uint16_t pc, stack[16];
+            uint8_t sp;
+            size_t romSize;
+            std::memcpy(&pc, state + offsetof(Chip8, pc), sizeof(pc));
+            std::memcpy(&sp, state + offsetof(Chip8, sp), sizeof(sp));
+            std::memcpy(stack, state + offsetof(Chip8, stack), sizeof(stack));
+            std::memcpy(&romSize, state + offsetof(Chip8, romSize), sizeof(romSize));
+            if (pc > Chip8::ADDRESS_MASK || sp >= 16 || romSize > Chip8::MAX_ROM_SIZE) {
+                return false;
+            }
+            for (int i = 1; i <= sp; i++) {
+                if (stack[i] > Chip8::ADDRESS_MASK) return false;
+            }
+            return true;
+        }
+};
+
+// Convenience for a single state, returns false if the file can't be used
+inline bool loadSnapshot(const std::string& path, Chip8& chip8) {
+    MappedSnapshots snapshots;
+    if (!snapshots.open(path) || snapshots.size() == 0) {
+        return false;
+    }
+    snapshots.restore(0, chip8);
+    return true;
+}
+
+#endif